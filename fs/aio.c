@@ -35,6 +35,7 @@
 #include <linux/eventfd.h>
 #include <linux/blkdev.h>
 #include <linux/compat.h>
+#include <linux/cred.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -55,6 +56,10 @@ static struct kmem_cache	*kiocb_cachep;
 static struct kmem_cache	*kioctx_cachep;
 
 static struct workqueue_struct *aio_wq;
+static struct workqueue_struct *aio_offload_wq;
+
+/* Offloaded iocbs in flight per cpu, across all contexts. */
+#define AIO_OFFLOAD_ACTIVE_PER_CPU	4
 
 /* Used for rare fput completion. */
 static void aio_fput_routine(struct work_struct *);
@@ -77,6 +82,9 @@ static int __init aio_setup(void)
 
 	aio_wq = alloc_workqueue("aio", 0, 1);	/* used to limit concurrency */
 	BUG_ON(!aio_wq);
+	aio_offload_wq = alloc_workqueue("aio_offload", WQ_UNBOUND,
+			AIO_OFFLOAD_ACTIVE_PER_CPU * num_possible_cpus());
+	BUG_ON(!aio_offload_wq);
 
 	pr_debug("aio_setup: sizeof(struct page) = %d\n", (int)sizeof(struct page));
 
@@ -1514,6 +1522,74 @@ static ssize_t aio_setup_iocb(struct kiocb *kiocb, bool compat)
 	return 0;
 }
 
+/*
+ * Buffered reads of regular files and block devices complete
+ * synchronously inside ->aio_read, so running them from io_submit()
+ * blocks the submitter on page cache misses.  Hand those to a worker
+ * instead.  Other files (sockets, pipes, ...) may block indefinitely and
+ * are left to their own ->aio_* implementation.
+ *
+ * Buffered writes stay inline: they check RLIMIT_FSIZE and send SIGXFSZ
+ * to current, and the filesystems charge quota and reserved blocks
+ * against it, none of which a worker can stand in for.
+ */
+static bool aio_should_offload(struct kiocb *req)
+{
+	struct file *file = req->ki_filp;
+	umode_t mode = file->f_path.dentry->d_inode->i_mode;
+
+	switch (req->ki_opcode) {
+	case IOCB_CMD_PREAD:
+	case IOCB_CMD_PREADV:
+		if (file->f_flags & O_DIRECT)
+			return false;
+		return S_ISREG(mode) || S_ISBLK(mode);
+	}
+	return false;
+}
+
+/*
+ * aio_offload_work:
+ *	Runs an offloaded iocb in the submitter's mm, like
+ *	aio_kick_handler() does for retries, and with the submitter's
+ *	credentials.
+ */
+static void aio_offload_work(struct work_struct *work)
+{
+	struct kiocb *iocb = container_of(work, struct kiocb, ki_work);
+	struct kioctx *ctx = iocb->ki_ctx;
+	struct mm_struct *mm = ctx->mm;
+	const struct cred *cred = iocb->ki_cred;
+	const struct cred *old_cred;
+	mm_segment_t oldfs = get_fs();
+
+	old_cred = override_creds(cred);
+	set_fs(USER_DS);
+	use_mm(mm);
+	spin_lock_irq(&ctx->ctx_lock);
+	aio_run_iocb(iocb);
+	__aio_put_req(ctx, iocb);	/* drop the worker's reference */
+	spin_unlock_irq(&ctx->ctx_lock);
+	unuse_mm(mm);
+	set_fs(oldfs);
+	revert_creds(old_cred);
+	put_cred(cred);
+}
+
+/*
+ * Queue @iocb to the offload workqueue.  Called with ctx_lock held, takes
+ * a reference on behalf of the worker.
+ */
+static void aio_offload_iocb(struct kiocb *iocb)
+{
+	assert_spin_locked(&iocb->ki_ctx->ctx_lock);
+
+	iocb->ki_users++;
+	iocb->ki_cred = get_current_cred();
+	INIT_WORK(&iocb->ki_work, aio_offload_work);
+	queue_work(aio_offload_wq, &iocb->ki_work);
+}
+
 static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 			 struct iocb *iocb, bool compat)
 {
@@ -1599,7 +1675,10 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 		ret = -EINVAL;
 		goto out_put_req;
 	}
-	aio_run_iocb(req);
+	if (aio_should_offload(req))
+		aio_offload_iocb(req);
+	else
+		aio_run_iocb(req);
 	if (!list_empty(&ctx->run_list)) {
 		/* drain the run list */
 		while (__aio_run_iocbs(ctx))
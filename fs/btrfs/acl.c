@@ -200,9 +200,7 @@ int btrfs_check_acl(struct inode *inode, int mask, unsigned int flags)
 	int error = -EAGAIN;
 
 	if (flags & IPERM_FLAG_RCU) {
-		if (!negative_cached_acl(inode, ACL_TYPE_ACCESS))
-			error = -ECHILD;
-
+		error = check_cached_acl_rcu(inode, mask);
 	} else {
 		struct posix_acl *acl;
 		acl = btrfs_get_acl(inode, ACL_TYPE_ACCESS);
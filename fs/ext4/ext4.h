@@ -857,6 +857,7 @@ struct ext4_inode_info {
 	/* current io_end structure for async DIO write*/
 	ext4_io_end_t *cur_aio_dio;
 	atomic_t i_aiodio_unwritten; /* Nr. of inflight conversions pending */
+	atomic_t i_dio_overwrite; /* Nr. of DIO overwrites without i_mutex */
 
 	spinlock_t i_block_reservation_lock;
 
@@ -1820,6 +1821,10 @@ extern int ext4_get_inode_loc(struct inode *, struct ext4_iloc *);
 extern int ext4_can_truncate(struct inode *inode);
 extern void ext4_truncate(struct inode *);
 extern int ext4_punch_hole(struct file *file, loff_t offset, loff_t length);
+extern int ext4_dio_can_overwrite(struct kiocb *iocb, struct inode *inode,
+				  loff_t offset, size_t count);
+extern ssize_t ext4_dio_overwrite(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t offset);
 extern int ext4_truncate_restart_trans(handle_t *, struct inode *, int nblocks);
 extern void ext4_set_inode_flags(struct inode *);
 extern void ext4_get_inode_flags(struct ext4_inode_info *);
@@ -2182,6 +2187,7 @@ extern int ext4_move_extents(struct file *o_filp, struct file *d_filp,
 extern int __init ext4_init_pageio(void);
 extern void ext4_exit_pageio(void);
 extern void ext4_ioend_wait(struct inode *);
+extern void ext4_dio_overwrite_wait(struct inode *);
 extern void ext4_free_io_end(ext4_io_end_t *io);
 extern ext4_io_end_t *ext4_init_io_end(struct inode *inode, gfp_t flags);
 extern int ext4_end_io_nolock(ext4_io_end_t *io);
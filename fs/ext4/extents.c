@@ -4163,6 +4163,8 @@ static int ext4_xattr_fiemap(struct inode *inode,
  * @offset: The starting byte offset of the hole
  * @length: The length of the hole
  *
+ * Called with i_mutex held.
+ *
  * Returns the number of blocks removed or negative on err
  */
 int ext4_ext_punch_hole(struct file *file, loff_t offset, loff_t length)
@@ -4191,6 +4193,12 @@ int ext4_ext_punch_hole(struct file *file, loff_t offset, loff_t length)
 	first_page_offset = first_page << PAGE_CACHE_SHIFT;
 	last_page_offset = last_page << PAGE_CACHE_SHIFT;
 
+	/*
+	 * Wait for DIO overwrites that may be writing to the blocks.  New
+	 * ones cannot start, as the caller holds i_mutex.
+	 */
+	ext4_dio_overwrite_wait(inode);
+
 	/*
 	 * Write out all dirty pages to avoid race conditions
 	 * Then release them.
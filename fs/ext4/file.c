@@ -89,6 +89,49 @@ ext4_unaligned_aio(struct inode *inode, const struct iovec *iov,
 	return 0;
 }
 
+/*
+ * Direct writes that only overwrite allocated, initialized blocks within
+ * i_size are issued without i_mutex, so that writers to different parts
+ * of a preallocated file run in parallel; see ext4_dio_can_overwrite().
+ * Returns 0 if the write has to go through generic_file_aio_write().
+ */
+static ssize_t
+ext4_file_dio_overwrite(struct kiocb *iocb, const struct iovec *iov,
+			unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_mapping->host;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+	int err;
+
+	vfs_check_frozen(inode->i_sb, SB_FREEZE_WRITE);
+
+	mutex_lock(&inode->i_mutex);
+	if (generic_write_checks(file, &pos, &count, 0) ||
+	    !ext4_dio_can_overwrite(iocb, inode, pos, count) ||
+	    file_remove_suid(file)) {
+		mutex_unlock(&inode->i_mutex);
+		return 0;
+	}
+	file_update_time(file);
+	atomic_inc(&EXT4_I(inode)->i_dio_overwrite);
+	mutex_unlock(&inode->i_mutex);
+
+	ret = ext4_dio_overwrite(iocb, iov, nr_segs, pos);
+
+	if (atomic_dec_and_test(&EXT4_I(inode)->i_dio_overwrite))
+		wake_up_all(ext4_ioend_wq(inode));
+
+	if (ret > 0) {
+		iocb->ki_pos = pos + ret;
+		err = generic_write_sync(file, pos, ret);
+		if (err < 0)
+			ret = err;
+	}
+	return ret;
+}
+
 static ssize_t
 ext4_file_write(struct kiocb *iocb, const struct iovec *iov,
 		unsigned long nr_segs, loff_t pos)
@@ -119,6 +162,13 @@ ext4_file_write(struct kiocb *iocb, const struct iovec *iov,
 		unaligned_aio = ext4_unaligned_aio(inode, iov, nr_segs, pos);
 	}
 
+	if ((iocb->ki_filp->f_flags & O_DIRECT) &&
+	    ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)) {
+		ret = ext4_file_dio_overwrite(iocb, iov, nr_segs, pos);
+		if (ret)
+			return ret;
+	}
+
 	/* Unaligned direct AIO must be serialized; see comment above */
 	if (unaligned_aio) {
 		static unsigned long unaligned_warn_time;
@@ -3704,6 +3704,70 @@ retry:
 	return 0;
 }
 
+/*
+ * ext4_get_block used for DIO overwrites.  The blocks were found mapped
+ * before i_mutex was dropped, so this never allocates.
+ */
+static int ext4_get_block_overwrite(struct inode *inode, sector_t iblock,
+		   struct buffer_head *bh_result, int create)
+{
+	return _ext4_get_block(inode, iblock, bh_result, 0);
+}
+
+/*
+ * Can this direct write run without i_mutex?  It can when it only
+ * overwrites blocks that are allocated and initialized already, so that
+ * neither block allocation, unwritten extent conversion nor an i_size
+ * update is needed.  Non-overlapping writers into a large preallocated
+ * file then proceed in parallel.  Truncate is kept out by i_alloc_sem,
+ * which the DIO code holds until the I/O is done, punch hole and extent
+ * moves wait on i_dio_overwrite.
+ *
+ * Only synchronous writes are handled this way, as the count has to be
+ * dropped once the I/O is complete.  Called with i_mutex held.
+ */
+int ext4_dio_can_overwrite(struct kiocb *iocb, struct inode *inode,
+			   loff_t offset, size_t count)
+{
+	struct ext4_map_blocks map;
+	unsigned int blkbits = inode->i_blkbits;
+	int len;
+
+	if (!is_sync_kiocb(iocb) || !ext4_should_dioread_nolock(inode))
+		return 0;
+	if (!count || inode->i_mapping->nrpages ||
+	    offset + count > i_size_read(inode))
+		return 0;
+
+	map.m_lblk = offset >> blkbits;
+	map.m_len = (EXT4_BLOCK_ALIGN(offset + count, blkbits) >> blkbits) -
+		map.m_lblk;
+	len = map.m_len;
+
+	return ext4_map_blocks(NULL, inode, &map, 0) == len &&
+		(map.m_flags & EXT4_MAP_MAPPED);
+}
+
+/*
+ * Issue a direct write that ext4_dio_can_overwrite() accepted.  Called
+ * without i_mutex, see ext4_file_dio_overwrite().
+ */
+ssize_t ext4_dio_overwrite(struct kiocb *iocb, const struct iovec *iov,
+			   unsigned long nr_segs, loff_t offset)
+{
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	ssize_t ret;
+
+	trace_ext4_direct_IO_enter(inode, offset, iov_length(iov, nr_segs),
+				   WRITE);
+	ret = blockdev_direct_IO(WRITE, iocb, inode, inode->i_sb->s_bdev,
+				 iov, offset, nr_segs,
+				 ext4_get_block_overwrite, NULL);
+	trace_ext4_direct_IO_exit(inode, offset, iov_length(iov, nr_segs),
+				  WRITE, ret);
+	return ret;
+}
+
 /*
  * For ext4 extent files, ext4 will do direct-io write to holes,
  * preallocated extents, and those write extend the file, no need to
@@ -4452,6 +4516,8 @@ int ext4_can_truncate(struct inode *inode)
 int ext4_punch_hole(struct file *file, loff_t offset, loff_t length)
 {
 	struct inode *inode = file->f_path.dentry->d_inode;
+	int ret;
+
 	if (!S_ISREG(inode->i_mode))
 		return -ENOTSUPP;
 
@@ -4460,7 +4526,15 @@ int ext4_punch_hole(struct file *file, loff_t offset, loff_t length)
 		return -ENOTSUPP;
 	}
 
-	return ext4_ext_punch_hole(file, offset, length);
+	/*
+	 * i_mutex keeps new DIO overwrites from mapping the blocks once
+	 * ext4_ext_punch_hole() has waited for the running ones.
+	 */
+	mutex_lock(&inode->i_mutex);
+	ret = ext4_ext_punch_hole(file, offset, length);
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
 }
 
 /*
@@ -1215,6 +1215,10 @@ ext4_move_extents(struct file *o_filp, struct file *d_filp,
 	if (ret1 < 0)
 		return ret1;
 
+	/* Wait for DIO overwrites into the blocks about to be exchanged */
+	ext4_dio_overwrite_wait(orig_inode);
+	ext4_dio_overwrite_wait(donor_inode);
+
 	/* Protect extent tree against block allocations via delalloc */
 	double_down_write_data_sem(orig_inode, donor_inode);
 	/* Check the filesystem environment whether move_extent can be done */
@@ -418,10 +418,16 @@ static inline void __file_sb_list_add(struct file *file, struct super_block *sb)
  * @sb: sb to add it to
  *
  * Use this function to associate a file with the superblock of the inode it
- * refers to.
+ * refers to.  Only regular files opened for writing are tracked, as they are
+ * all that remounting read-only has to look at; other opens do not touch
+ * files_lglock at all.
  */
 void file_sb_list_add(struct file *file, struct super_block *sb)
 {
+	if (!(file->f_mode & FMODE_WRITE) ||
+	    !S_ISREG(file->f_path.dentry->d_inode->i_mode))
+		return;
+
 	lg_local_lock(files_lglock);
 	__file_sb_list_add(file, sb);
 	lg_local_unlock(files_lglock);
@@ -474,23 +480,46 @@ void file_sb_list_del(struct file *file)
 
 #endif
 
+/*
+ * Is any inode of the superblock unlinked but still in use?  Its final
+ * iput will have to write to the filesystem.  Unreferenced inodes with no
+ * links are evicted right away, so any that are still around are pinned.
+ */
+static int sb_has_pending_deletes(struct super_block *sb)
+{
+	struct inode *inode;
+	int ret = 0;
+
+	spin_lock(&inode_sb_list_lock);
+	list_for_each_entry(inode, &sb->s_inodes, i_sb_list) {
+		spin_lock(&inode->i_lock);
+		if (inode->i_nlink == 0 && atomic_read(&inode->i_count) &&
+		    !(inode->i_state & (I_NEW | I_FREEING | I_WILL_FREE)))
+			ret = 1;
+		spin_unlock(&inode->i_lock);
+		if (ret)
+			break;
+	}
+	spin_unlock(&inode_sb_list_lock);
+	return ret;
+}
+
 int fs_may_remount_ro(struct super_block *sb)
 {
 	struct file *file;
 	/* Check that no files are currently opened for writing. */
 	lg_global_lock(files_lglock);
 	do_file_list_for_each_entry(sb, file) {
-		struct inode *inode = file->f_path.dentry->d_inode;
-
-		/* File with pending delete? */
-		if (inode->i_nlink == 0)
-			goto too_bad;
-
 		/* Writeable file? */
-		if (S_ISREG(inode->i_mode) && (file->f_mode & FMODE_WRITE))
+		if (file->f_mode & FMODE_WRITE)
 			goto too_bad;
 	} while_file_list_for_each_entry;
 	lg_global_unlock(files_lglock);
+
+	/* File with pending delete? */
+	if (sb_has_pending_deletes(sb))
+		return 0;
+
 	return 1; /* Tis' cool bro. */
 too_bad:
 	lg_global_unlock(files_lglock);
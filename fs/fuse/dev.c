@@ -227,6 +227,15 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 	return nbytes;
 }
 
+/*
+ * Unique IDs are handed out sequentially, so their low bits spread the
+ * requests evenly over the processing hash chains.
+ */
+static struct list_head *fuse_processing_list(struct fuse_conn *fc, u64 unique)
+{
+	return &fc->processing[unique & (FUSE_PQ_HASH_SIZE - 1)];
+}
+
 static u64 fuse_get_unique(struct fuse_conn *fc)
 {
 	fc->reqctr++;
@@ -532,6 +541,7 @@ struct fuse_copy_state {
 	struct pipe_buffer *currbuf;
 	struct pipe_inode_info *pipe;
 	unsigned long nr_segs;
+	unsigned int nr_bufs_max;	/* size of pipebufs[] */
 	unsigned long seglen;
 	unsigned long addr;
 	struct page *pg;
@@ -606,7 +616,7 @@ static int fuse_copy_fill(struct fuse_copy_state *cs)
 		} else {
 			struct page *page;
 
-			if (cs->nr_segs == cs->pipe->buffers)
+			if (cs->nr_segs == cs->nr_bufs_max)
 				return -EIO;
 
 			page = alloc_page(GFP_HIGHUSER);
@@ -786,7 +796,7 @@ static int fuse_ref_page(struct fuse_copy_state *cs, struct page *page,
 {
 	struct pipe_buffer *buf;
 
-	if (cs->nr_segs == cs->pipe->buffers)
+	if (cs->nr_segs == cs->nr_bufs_max)
 		return -EIO;
 
 	unlock_request(cs->fc, cs->req);
@@ -1169,7 +1179,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		request_end(fc, req);
 	else {
 		req->state = FUSE_REQ_SENT;
-		list_move_tail(&req->list, &fc->processing);
+		list_move_tail(&req->list,
+			       fuse_processing_list(fc, req->in.h.unique));
 		if (req->interrupted)
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
@@ -1218,18 +1229,25 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int ret;
 	int page_nr = 0;
 	int do_wakeup = 0;
+	unsigned int nr_bufs;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
 	struct fuse_conn *fc = fuse_get_conn(in);
 	if (!fc)
 		return -EPERM;
 
-	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
+	/*
+	 * pipe->buffers may change until the pipe is locked below, so the
+	 * copy is bounded by the size sampled here, not the live value.
+	 */
+	nr_bufs = ACCESS_ONCE(pipe->buffers);
+	bufs = kmalloc(nr_bufs * sizeof(struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
 	fuse_copy_init(&cs, fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
+	cs.nr_bufs_max = nr_bufs;
 	cs.pipe = pipe;
 	ret = fuse_dev_do_read(fc, in, &cs, len);
 	if (ret < 0)
@@ -1598,17 +1616,27 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 	}
 }
 
-/* Look up request on processing list by unique ID */
+/*
+ * Look up request on processing list by unique ID.  Replies to requests
+ * are found on the hash chain of their ID, replies to interrupts (whose
+ * IDs are unrelated to the request's) need a full search, but those are
+ * rare.
+ */
 static struct fuse_req *request_find(struct fuse_conn *fc, u64 unique)
 {
-	struct list_head *entry;
+	struct fuse_req *req;
+	int i;
 
-	list_for_each(entry, &fc->processing) {
-		struct fuse_req *req;
-		req = list_entry(entry, struct fuse_req, list);
-		if (req->in.h.unique == unique || req->intr_unique == unique)
+	list_for_each_entry(req, fuse_processing_list(fc, unique), list) {
+		if (req->in.h.unique == unique)
 			return req;
 	}
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++) {
+		list_for_each_entry(req, &fc->processing[i], list) {
+			if (req->intr_unique == unique)
+				return req;
+		}
+	}
 	return NULL;
 }
 
@@ -1764,11 +1792,14 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	if (!fc)
 		return -EPERM;
 
+	/* Sized under the pipe lock, which pipe_grow() also takes */
+	pipe_lock(pipe);
 	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
-	if (!bufs)
+	if (!bufs) {
+		pipe_unlock(pipe);
 		return -ENOMEM;
+	}
 
-	pipe_lock(pipe);
 	nbuf = 0;
 	rem = 0;
 	for (idx = 0; idx < pipe->nrbufs && rem < len; idx++)
@@ -1904,10 +1935,13 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	int i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
 	end_requests(fc, &fc->pending);
-	end_requests(fc, &fc->processing);
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		end_requests(fc, &fc->processing[i]);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
 }
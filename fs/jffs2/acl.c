@@ -265,7 +265,7 @@ int jffs2_check_acl(struct inode *inode, int mask, unsigned int flags)
 	int rc;
 
 	if (flags & IPERM_FLAG_RCU)
-		return -ECHILD;
+		return check_cached_acl_rcu(inode, mask);
 
 	acl = jffs2_get_acl(inode, ACL_TYPE_ACCESS);
 	if (IS_ERR(acl))
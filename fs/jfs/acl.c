@@ -119,7 +119,7 @@ int jfs_check_acl(struct inode *inode, int mask, unsigned int flags)
 	struct posix_acl *acl;
 
 	if (flags & IPERM_FLAG_RCU)
-		return -ECHILD;
+		return check_cached_acl_rcu(inode, mask);
 
 	acl = jfs_get_acl(inode, ACL_TYPE_ACCESS);
 	if (IS_ERR(acl))
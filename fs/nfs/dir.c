@@ -1080,6 +1080,67 @@ int nfs_neg_need_reval(struct inode *dir, struct dentry *dentry,
 	return !nfs_check_verifier(dir, dentry);
 }
 
+/*
+ * RCU path walk version of nfs_check_verifier(): the parent directory
+ * attributes are only trusted while they are still cached.
+ */
+static int nfs_check_verifier_rcu(struct inode *dir, struct dentry *dentry)
+{
+	if (IS_ROOT(dentry))
+		return 1;
+	if (NFS_SERVER(dir)->flags & NFS_MOUNT_LOOKUP_CACHE_NONE)
+		return 0;
+	if (nfs_revalidate_inode_rcu(NFS_SERVER(dir), dir) < 0)
+		return 0;
+	return nfs_verify_change_attribute(dir, dentry->d_time);
+}
+
+/*
+ * Revalidate a dentry in RCU path walk mode.  Only the cases that can
+ * be decided from the attribute caches are handled, and the dentry is
+ * never invalidated here: anything else returns -ECHILD and is redone
+ * by nfs_lookup_revalidate() in ref-walk mode.
+ */
+static int nfs_lookup_revalidate_rcu(struct dentry *dentry,
+				     struct nameidata *nd)
+{
+	struct dentry *parent = ACCESS_ONCE(dentry->d_parent);
+	struct inode *dir = ACCESS_ONCE(parent->d_inode);
+	struct inode *inode = ACCESS_ONCE(dentry->d_inode);
+
+	if (!dir)
+		return -ECHILD;
+
+	if (!inode) {
+		if (nfs_lookup_check_intent(nd, LOOKUP_CREATE) != 0)
+			return 1;
+		if (NFS_SERVER(dir)->flags & NFS_MOUNT_LOOKUP_CACHE_NONEG)
+			return -ECHILD;
+		return nfs_check_verifier_rcu(dir, dentry) ? 1 : -ECHILD;
+	}
+
+	if (is_bad_inode(inode) || NFS_STALE(inode))
+		return -ECHILD;
+
+	if (nfs_have_delegation(inode, FMODE_READ))
+		return 1;
+
+	if (nfs_is_exclusive_create(dir, nd) ||
+	    !nfs_check_verifier_rcu(dir, dentry))
+		return -ECHILD;
+
+	/* Cases where nfs_lookup_verify_inode() would go to the server */
+	if (IS_AUTOMOUNT(inode))
+		return 1;
+	if (nd->flags & LOOKUP_REVAL)
+		return -ECHILD;
+	if (nfs_lookup_check_intent(nd, LOOKUP_OPEN) != 0 &&
+	    !(NFS_SERVER(inode)->flags & NFS_MOUNT_NOCTO) &&
+	    (S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode)))
+		return -ECHILD;
+	return 1;
+}
+
 /*
  * This is called every time the dcache has a lookup hit,
  * and we should check whether we can really trust that
@@ -1101,7 +1162,7 @@ static int nfs_lookup_revalidate(struct dentry *dentry, struct nameidata *nd)
 	int error;
 
 	if (nd->flags & LOOKUP_RCU)
-		return -ECHILD;
+		return nfs_lookup_revalidate_rcu(dentry, nd);
 
 	parent = dget_parent(dentry);
 	dir = parent->d_inode;
@@ -1498,12 +1559,13 @@ static int nfs_open_revalidate(struct dentry *dentry, struct nameidata *nd)
 	struct nfs_open_context *ctx;
 	int openflags, ret = 0;
 
+	if (!is_atomic_open(nd) || d_mountpoint(dentry))
+		goto no_open;
+
 	if (nd->flags & LOOKUP_RCU)
 		return -ECHILD;
 
 	inode = dentry->d_inode;
-	if (!is_atomic_open(nd) || d_mountpoint(dentry))
-		goto no_open;
 
 	parent = dget_parent(dentry);
 	dir = parent->d_inode;
@@ -2176,6 +2238,35 @@ out_zap:
 	return -ENOENT;
 }
 
+/*
+ * Look up the access cache without blocking, for RCU path walk.  Unlike
+ * nfs_access_get_cached() this never changes the cache, stale entries
+ * are left for ref-walk to deal with.
+ */
+static int nfs_access_get_cached_rcu(struct inode *inode, struct rpc_cred *cred, struct nfs_access_entry *res)
+{
+	struct nfs_inode *nfsi = NFS_I(inode);
+	struct nfs_access_entry *cache;
+	int err = -ECHILD;
+
+	spin_lock(&inode->i_lock);
+	if (nfsi->cache_validity & NFS_INO_INVALID_ACCESS)
+		goto out;
+	cache = nfs_access_search_rbtree(inode, cred);
+	if (cache == NULL)
+		goto out;
+	if (!nfs_have_delegated_attributes(inode) &&
+	    !time_in_range_open(jiffies, cache->jiffies, cache->jiffies + nfsi->attrtimeo))
+		goto out;
+	res->jiffies = cache->jiffies;
+	res->cred = cache->cred;
+	res->mask = cache->mask;
+	err = 0;
+out:
+	spin_unlock(&inode->i_lock);
+	return err;
+}
+
 static void nfs_access_add_rbtree(struct inode *inode, struct nfs_access_entry *set)
 {
 	struct nfs_inode *nfsi = NFS_I(inode);
@@ -2265,6 +2356,19 @@ out:
 	return -EACCES;
 }
 
+static int nfs_do_access_rcu(struct inode *inode, struct rpc_cred *cred, int mask)
+{
+	struct nfs_access_entry cache;
+	int status;
+
+	status = nfs_access_get_cached_rcu(inode, cred, &cache);
+	if (status != 0)
+		return status;
+	if ((mask & ~cache.mask & (MAY_READ | MAY_WRITE | MAY_EXEC)) == 0)
+		return 0;
+	return -EACCES;
+}
+
 static int nfs_open_permission_mask(int openflags)
 {
 	int mask = 0;
@@ -2288,9 +2392,6 @@ int nfs_permission(struct inode *inode, int mask, unsigned int flags)
 	struct rpc_cred *cred;
 	int res = 0;
 
-	if (flags & IPERM_FLAG_RCU)
-		return -ECHILD;
-
 	nfs_inc_stats(inode, NFSIOS_VFSACCESS);
 
 	if ((mask & (MAY_READ | MAY_WRITE | MAY_EXEC)) == 0)
@@ -2322,6 +2423,19 @@ force_lookup:
 	if (!NFS_PROTO(inode)->access)
 		goto out_notsup;
 
+	/* In RCU path walk, only the access cache can be used */
+	if (flags & IPERM_FLAG_RCU) {
+		cred = rpc_lookup_cred_nonblock();
+		if (!IS_ERR(cred)) {
+			res = nfs_do_access_rcu(inode, cred, mask);
+			put_rpccred(cred);
+		} else
+			res = PTR_ERR(cred);
+		if (res == -ECHILD)
+			return res;
+		goto out;
+	}
+
 	cred = rpc_lookup_cred();
 	if (!IS_ERR(cred)) {
 		res = nfs_do_access(inode, cred, mask);
@@ -2336,7 +2450,12 @@ out:
 		inode->i_sb->s_id, inode->i_ino, mask, res);
 	return res;
 out_notsup:
-	res = nfs_revalidate_inode(NFS_SERVER(inode), inode);
+	if (flags & IPERM_FLAG_RCU)
+		res = nfs_revalidate_inode_rcu(NFS_SERVER(inode), inode);
+	else
+		res = nfs_revalidate_inode(NFS_SERVER(inode), inode);
+	if (res == -ECHILD)
+		return res;
 	if (res == 0)
 		res = generic_permission(inode, mask, flags, NULL);
 	goto out;
@@ -844,6 +844,22 @@ int nfs_revalidate_inode(struct nfs_server *server, struct inode *inode)
 	return __nfs_revalidate_inode(server, inode);
 }
 
+/**
+ * nfs_revalidate_inode_rcu - Check the inode attributes without blocking
+ * @server - pointer to nfs_server struct
+ * @inode - pointer to inode struct
+ *
+ * Like nfs_revalidate_inode(), but returns -ECHILD instead of going to
+ * the server, for use in RCU path walk.
+ */
+int nfs_revalidate_inode_rcu(struct nfs_server *server, struct inode *inode)
+{
+	if ((NFS_I(inode)->cache_validity & NFS_INO_INVALID_ATTR)
+			|| nfs_attribute_cache_expired(inode))
+		return -ECHILD;
+	return NFS_STALE(inode) ? -ESTALE : 0;
+}
+
 static int nfs_invalidate_mapping(struct inode *inode, struct address_space *mapping)
 {
 	struct nfs_inode *nfsi = NFS_I(inode);
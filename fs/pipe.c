@@ -35,6 +35,13 @@ unsigned int pipe_max_size = 1048576;
  */
 unsigned int pipe_min_size = PAGE_SIZE;
 
+/*
+ * The number of pipe buffer pages a user may hold before pipes stop
+ * growing automatically, can be set in /proc/sys/fs/pipe-user-pages.
+ * Zero disables automatic growth.
+ */
+unsigned long pipe_user_pages = 16384;
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -599,7 +606,7 @@ redo2:
 			if (!total_len)
 				break;
 		}
-		if (bufs < pipe->buffers)
+		if (bufs < pipe->buffers || pipe_grow(pipe))
 			continue;
 		if (filp->f_flags & O_NONBLOCK) {
 			if (!ret)
@@ -902,6 +909,8 @@ struct pipe_inode_info * alloc_pipe_info(struct inode *inode)
 			pipe->r_counter = pipe->w_counter = 1;
 			pipe->inode = inode;
 			pipe->buffers = PIPE_DEF_BUFFERS;
+			pipe->user = get_current_user();
+			atomic_long_add(PIPE_DEF_BUFFERS, &pipe->user->pipe_bufs);
 			return pipe;
 		}
 		kfree(pipe);
@@ -921,6 +930,8 @@ void __free_pipe_info(struct pipe_inode_info *pipe)
 	}
 	if (pipe->tmp_page)
 		__free_page(pipe->tmp_page);
+	atomic_long_sub(pipe->buffers, &pipe->user->pipe_bufs);
+	free_uid(pipe->user);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1162,6 +1173,7 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 			memcpy(bufs + head, pipe->bufs, tail * sizeof(struct pipe_buffer));
 	}
 
+	atomic_long_add((long)nr_pages - pipe->buffers, &pipe->user->pipe_bufs);
 	pipe->curbuf = 0;
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
@@ -1169,6 +1181,32 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	return nr_pages * PAGE_SIZE;
 }
 
+/**
+ * pipe_grow - make room in a full pipe
+ * @pipe:	the pipe, locked
+ *
+ * Description:
+ *	Called by pipe_write() when it finds @pipe full, before it waits
+ *	for the reader. Doubles the buffer array as long as it stays within
+ *	pipe_max_size and the owning user within pipe_user_pages, so that
+ *	pipes under sustained load stop bouncing between writer and reader
+ *	every PIPE_DEF_BUFFERS pages. Returns true if there is room now.
+ *	Splice does not call this: splice_pipe_desc arrays are sized from
+ *	pipe->buffers before the pipe lock is taken.
+ */
+bool pipe_grow(struct pipe_inode_info *pipe)
+{
+	unsigned long nr_pages = pipe->buffers * 2;
+
+	if (nr_pages * PAGE_SIZE > pipe_max_size)
+		return false;
+	if (atomic_long_read(&pipe->user->pipe_bufs) + pipe->buffers >
+	    pipe_user_pages)
+		return false;
+
+	return pipe_set_size(pipe, nr_pages) > 0;
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages.
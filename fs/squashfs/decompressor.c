@@ -22,7 +22,11 @@
  */
 
 #include <linux/types.h>
-#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/cpumask.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
 
@@ -77,34 +81,192 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 }
 
 
-void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
+/*
+ * Decompressor streams are kept in a per-filesystem pool, so that blocks
+ * can be decompressed in parallel.  The pool starts with one stream, and
+ * more are created on demand when all are busy, up to one per online CPU.
+ * Streams are never freed before unmount.
+ */
+struct squashfs_stream {
+	struct list_head	list;
+	void			*stream;
+};
+
+
+int squashfs_max_decompressors(void)
+{
+	return num_online_cpus();
+}
+
+
+static struct squashfs_stream *squashfs_stream_alloc(
+	struct squashfs_sb_info *msblk, struct squashfs_stream_pool *pool)
+{
+	struct squashfs_stream *s;
+	void *strm;
+
+	s = kmalloc(sizeof(*s), GFP_KERNEL);
+	if (s == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	strm = msblk->decompressor->init(msblk, pool->comp_opts,
+		pool->comp_opts_len);
+	if (IS_ERR(strm)) {
+		kfree(s);
+		return strm;
+	}
+
+	s->stream = strm;
+	return s;
+}
+
+
+struct squashfs_stream_pool *squashfs_decompressor_init(struct super_block *sb,
+	unsigned short flags)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	void *strm, *buffer = NULL;
-	int length = 0;
+	struct squashfs_stream_pool *pool;
+	struct squashfs_stream *s;
+	void *buffer = NULL;
+	int length = 0, err;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->idle);
+	init_waitqueue_head(&pool->wait_queue);
+	pool->max_streams = squashfs_max_decompressors();
 
 	/*
-	 * Read decompressor specific options from file system if present
+	 * Read decompressor specific options from file system if present.
+	 * They are kept for the lifetime of the pool, as every stream created
+	 * later on is initialised from them.
 	 */
 	if (SQUASHFS_COMP_OPTS(flags)) {
 		buffer = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
-		if (buffer == NULL)
-			return ERR_PTR(-ENOMEM);
+		if (buffer == NULL) {
+			err = -ENOMEM;
+			goto failed;
+		}
 
 		length = squashfs_read_data(sb, &buffer,
 			sizeof(struct squashfs_super_block), 0, NULL,
 			PAGE_CACHE_SIZE, 1);
 
 		if (length < 0) {
-			strm = ERR_PTR(length);
-			goto finished;
+			err = length;
+			goto failed;
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	pool->comp_opts = buffer;
+	pool->comp_opts_len = length;
+
+	s = squashfs_stream_alloc(msblk, pool);
+	if (IS_ERR(s)) {
+		err = PTR_ERR(s);
+		goto failed;
+	}
+
+	list_add(&s->list, &pool->idle);
+	pool->streams = 1;
 
-finished:
+	return pool;
+
+failed:
 	kfree(buffer);
+	kfree(pool);
+	return ERR_PTR(err);
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
+	struct squashfs_stream_pool *pool)
+{
+	struct squashfs_stream *s, *next;
+
+	if (pool == NULL)
+		return;
+
+	list_for_each_entry_safe(s, next, &pool->idle, list) {
+		msblk->decompressor->free(s->stream);
+		kfree(s);
+	}
+
+	kfree(pool->comp_opts);
+	kfree(pool);
+}
+
+
+/*
+ * Take an idle stream from the pool.  If there is none, try to grow the
+ * pool, otherwise wait for a stream to be returned.
+ */
+static struct squashfs_stream *squashfs_stream_get(
+	struct squashfs_sb_info *msblk, struct squashfs_stream_pool *pool)
+{
+	struct squashfs_stream *s;
+
+	spin_lock(&pool->lock);
+
+	while (1) {
+		if (!list_empty(&pool->idle)) {
+			s = list_first_entry(&pool->idle,
+				struct squashfs_stream, list);
+			list_del(&s->list);
+			break;
+		}
+
+		if (pool->streams < pool->max_streams) {
+			pool->streams++;
+			spin_unlock(&pool->lock);
+
+			s = squashfs_stream_alloc(msblk, pool);
+			if (!IS_ERR(s))
+				return s;
+
+			/*
+			 * Failing to grow the pool is not an error, there is
+			 * always at least one stream to wait for.
+			 */
+			spin_lock(&pool->lock);
+			pool->streams--;
+		}
+
+		spin_unlock(&pool->lock);
+		wait_event(pool->wait_queue, !list_empty(&pool->idle));
+		spin_lock(&pool->lock);
+	}
+
+	spin_unlock(&pool->lock);
+	return s;
+}
+
+
+static void squashfs_stream_put(struct squashfs_stream_pool *pool,
+	struct squashfs_stream *s)
+{
+	spin_lock(&pool->lock);
+	list_add(&s->list, &pool->idle);
+	spin_unlock(&pool->lock);
+
+	wake_up(&pool->wait_queue);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream_pool *pool = msblk->stream;
+	struct squashfs_stream *s = squashfs_stream_get(msblk, pool);
+	int res;
+
+	res = msblk->decompressor->decompress(msblk, s->stream, buffer, bh, b,
+		offset, length, srclength, pages);
 
-	return strm;
+	squashfs_stream_put(pool, s);
+	return res;
 }
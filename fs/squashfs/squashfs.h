@@ -48,7 +48,13 @@ extern void *squashfs_read_table(struct super_block *, u64, int);
 
 /* decompressor.c */
 extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
-extern void *squashfs_decompressor_init(struct super_block *, unsigned short);
+extern int squashfs_max_decompressors(void);
+extern struct squashfs_stream_pool *squashfs_decompressor_init(
+				struct super_block *, unsigned short);
+extern void squashfs_decompressor_free(struct squashfs_sb_info *,
+				struct squashfs_stream_pool *);
+extern int squashfs_decompress(struct squashfs_sb_info *, void **,
+				struct buffer_head **, int, int, int, int, int);
 
 /* export.c */
 extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64, u64,
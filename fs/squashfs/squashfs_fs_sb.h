@@ -51,6 +51,16 @@ struct squashfs_cache_entry {
 	void			**data;
 };
 
+struct squashfs_stream_pool {
+	spinlock_t		lock;
+	struct list_head	idle;
+	int			streams;
+	int			max_streams;
+	wait_queue_head_t	wait_queue;
+	void			*comp_opts;
+	int			comp_opts_len;
+};
+
 struct squashfs_sb_info {
 	const struct squashfs_decompressor	*decompressor;
 	int					devblksize;
@@ -62,10 +72,9 @@ struct squashfs_sb_info {
 	__le64					*id_table;
 	__le64					*fragment_index;
 	__le64					*xattr_id_table;
-	struct mutex				read_data_mutex;
 	struct mutex				meta_index_mutex;
 	struct meta_index			*meta_index;
-	void					*stream;
+	struct squashfs_stream_pool		*stream;
 	__le64					*inode_lookup_table;
 	u64					inode_table;
 	u64					directory_table;
@@ -13,6 +13,7 @@
 #define AIO_KIOGRP_NR_ATOMIC	8
 
 struct kioctx;
+struct cred;
 
 /* Notes on cancelling a kiocb:
  *	If a kiocb is cancelled, aio_complete may return 0 to indicate 
@@ -117,6 +118,10 @@ struct kiocb {
 
 	struct list_head	ki_list;	/* the aio core uses this
 						 * for cancellation */
+	struct work_struct	ki_work;	/* offloaded submission,
+						 * see aio_offload_iocb() */
+	const struct cred	*ki_cred;	/* submitter's creds while
+						 * offloaded */
 
 	/*
 	 * If the aio_resfd field of the userspace iocb is not zero,
@@ -919,6 +919,8 @@ struct file_ra_state {
 
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
+	unsigned int stride_gap;	/* Distance of the last random miss
+					   past the previous read, in pages */
 	loff_t prev_pos;		/* Cache last read() position */
 };
 
@@ -225,6 +225,12 @@ struct hstate {
 	unsigned int nr_huge_pages_node[MAX_NUMNODES];
 	unsigned int free_huge_pages_node[MAX_NUMNODES];
 	unsigned int surplus_huge_pages_node[MAX_NUMNODES];
+	/* fault-time locality, counted against the preferred node */
+	unsigned long local_huge_pages_node[MAX_NUMNODES];
+	unsigned long remote_huge_pages_node[MAX_NUMNODES];
+	/* remote faults not yet acted upon by the rebalancer */
+	unsigned int demand_huge_pages_node[MAX_NUMNODES];
+	unsigned int rebalance;
 	char name[HSTATE_NAME_LEN];
 };
 
@@ -619,11 +619,27 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/*
+ * Commit times are counted in power of two buckets of microseconds:
+ * bucket n holds commits that took less than 2^(n+1)us, the last bucket
+ * holds everything slower.
+ */
+#define JBD2_COMMIT_HIST_BUCKETS	24
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+	unsigned long		ts_commit_hist[JBD2_COMMIT_HIST_BUCKETS];
 };
 
+static inline int jbd2_commit_hist_bucket(u64 commit_time)
+{
+	u64 usecs = div_u64(commit_time, NSEC_PER_USEC);
+	int bucket = usecs ? fls64(usecs) - 1 : 0;
+
+	return min(bucket, JBD2_COMMIT_HIST_BUCKETS - 1);
+}
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
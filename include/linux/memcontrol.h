@@ -39,6 +39,18 @@ extern unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 					struct mem_cgroup *mem_cont,
 					int active, int file);
 
+/*
+ * Memory stall accounting: a task that has to wait for memory (direct
+ * reclaim, compaction, swap-in, dirty throttling) brackets the wait with
+ * mem_cgroup_stall_begin() and mem_cgroup_stall_end().
+ */
+struct mem_cgroup_stall {
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	struct mem_cgroup *mem;
+	u64 start;
+#endif
+};
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
 /*
  * All "charge" functions with gfp_mask should use GFP_KERNEL or
@@ -153,6 +165,8 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
+void mem_cgroup_stall_begin(struct mem_cgroup_stall *stall);
+void mem_cgroup_stall_end(struct mem_cgroup_stall *stall);
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 void mem_cgroup_split_huge_fixup(struct page *head, struct page *tail);
 #endif
@@ -370,6 +384,14 @@ static inline
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
 {
 }
+
+static inline void mem_cgroup_stall_begin(struct mem_cgroup_stall *stall)
+{
+}
+
+static inline void mem_cgroup_stall_end(struct mem_cgroup_stall *stall)
+{
+}
 #endif /* CONFIG_CGROUP_MEM_CONT */
 
 #if !defined(CONFIG_CGROUP_MEM_RES_CTLR) || !defined(CONFIG_DEBUG_VM)
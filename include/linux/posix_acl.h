@@ -9,6 +9,7 @@
 #define __LINUX_POSIX_ACL_H
 
 #include <linux/slab.h>
+#include <linux/rcupdate.h>
 
 #define ACL_UNDEFINED_ID	(-1)
 
@@ -38,7 +39,10 @@ struct posix_acl_entry {
 };
 
 struct posix_acl {
-	atomic_t		a_refcount;
+	union {
+		atomic_t		a_refcount;
+		struct rcu_head		a_rcu;
+	};
 	unsigned int		a_count;
 	struct posix_acl_entry	a_entries[0];
 };
@@ -59,13 +63,14 @@ posix_acl_dup(struct posix_acl *acl)
 }
 
 /*
- * Free an ACL handle.
+ * Free an ACL handle.  ACLs cached in an inode may still be looked at by
+ * an RCU path walk, so they are freed after a grace period.
  */
 static inline void
 posix_acl_release(struct posix_acl *acl)
 {
 	if (acl && atomic_dec_and_test(&acl->a_refcount))
-		kfree(acl);
+		kfree_rcu(acl, a_rcu);
 }
 
 
@@ -128,20 +133,37 @@ static inline int negative_cached_acl(struct inode *inode, int type)
 	return 1;
 }
 
+/*
+ * Check permissions against the cached access ACL of an inode without
+ * taking a reference, for RCU path walk.  Returns -ECHILD if the ACL is
+ * not cached and -EAGAIN if the inode has none, like ->check_acl.
+ */
+static inline int check_cached_acl_rcu(struct inode *inode, int mask)
+{
+	struct posix_acl *acl = rcu_dereference(inode->i_acl);
+
+	if (acl == ACL_NOT_CACHED)
+		return -ECHILD;
+	if (!acl)
+		return -EAGAIN;
+	return posix_acl_permission(inode, acl, mask);
+}
+
 static inline void set_cached_acl(struct inode *inode,
 				  int type,
 				  struct posix_acl *acl)
 {
 	struct posix_acl *old = NULL;
+	posix_acl_dup(acl);
 	spin_lock(&inode->i_lock);
 	switch (type) {
 	case ACL_TYPE_ACCESS:
 		old = inode->i_acl;
-		inode->i_acl = posix_acl_dup(acl);
+		rcu_assign_pointer(inode->i_acl, acl);
 		break;
 	case ACL_TYPE_DEFAULT:
 		old = inode->i_default_acl;
-		inode->i_default_acl = posix_acl_dup(acl);
+		rcu_assign_pointer(inode->i_default_acl, acl);
 		break;
 	}
 	spin_unlock(&inode->i_lock);
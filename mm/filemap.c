@@ -523,6 +523,96 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/**
+ * add_to_page_cache_lru_vec - add a batch of new pages to the page cache
+ * @pvec:	newly allocated pages, with ->index set
+ * @mapping:	the address_space to add them to
+ * @gfp_mask:	page allocation mode
+ *
+ * This is add_to_page_cache_lru() on each page of @pvec, but the radix tree
+ * insertions are done under one radix_tree_preload() and one hold of the
+ * tree_lock for as long as the preloaded nodes last, rather than once per
+ * page.  Pages that were added are returned locked with ->mapping set to
+ * @mapping; the others are returned unlocked with ->mapping left NULL.
+ *
+ * Returns the number of pages added.
+ */
+int add_to_page_cache_lru_vec(struct pagevec *pvec,
+				struct address_space *mapping, gfp_t gfp_mask)
+{
+	unsigned int nr = pagevec_count(pvec);
+	unsigned long charged = 0, added = 0;
+	unsigned int i;
+	int error;
+
+	/* Charging may sleep, so do it before taking the tree_lock */
+	for (i = 0; i < nr; i++) {
+		struct page *page = pvec->pages[i];
+
+		if (mapping_cap_swap_backed(mapping))
+			SetPageSwapBacked(page);
+		__set_page_locked(page);
+		if (!mem_cgroup_cache_charge(page, current->mm,
+					gfp_mask & GFP_RECLAIM_MASK))
+			charged |= 1UL << i;
+	}
+
+	i = 0;
+	while (i < nr) {
+		bool preloaded = true;
+
+		if (radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM))
+			break;
+
+		spin_lock_irq(&mapping->tree_lock);
+		for (; i < nr; i++) {
+			struct page *page = pvec->pages[i];
+
+			if (!(charged & (1UL << i)))
+				continue;
+
+			page->mapping = mapping;
+			error = radix_tree_insert(&mapping->page_tree,
+						  page->index, page);
+			if (unlikely(error)) {
+				page->mapping = NULL;
+				/* Out of preloaded nodes: refill and retry */
+				if (error == -ENOMEM && !preloaded)
+					break;
+				preloaded = false;
+				continue;
+			}
+			preloaded = false;
+			page_cache_get(page);
+			mapping->nrpages++;
+			__inc_zone_page_state(page, NR_FILE_PAGES);
+			if (PageSwapBacked(page))
+				__inc_zone_page_state(page, NR_SHMEM);
+			added |= 1UL << i;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+		radix_tree_preload_end();
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = pvec->pages[i];
+
+		if (added & (1UL << i)) {
+			if (page_is_file_cache(page))
+				lru_cache_add_file(page);
+			else
+				lru_cache_add_anon(page);
+			continue;
+		}
+		if (charged & (1UL << i))
+			mem_cgroup_uncharge_cache_page(page);
+		__clear_page_locked(page);
+	}
+
+	return hweight_long(added);
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_vec);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -1067,6 +1157,54 @@ static void shrink_readahead_size_eio(struct file *filp,
 	ra->ra_pages /= 4;
 }
 
+/*
+ * Drop the pages of @pvec that were not handed out, and empty it.
+ */
+static void filemap_release_batch(struct pagevec *pvec, unsigned int *next)
+{
+	while (*next < pagevec_count(pvec))
+		page_cache_release(pvec->pages[(*next)++]);
+	pagevec_reinit(pvec);
+	*next = 0;
+}
+
+/*
+ * Return the page at @index with a reference held, like find_get_page().
+ *
+ * Streaming reads would otherwise walk the radix tree once per page: so
+ * look up the pages cached contiguously from @index, up to @last_index,
+ * in a single gang lookup, and hand them out of @pvec one at a time as
+ * the read advances.  Pages still in the batch hold their own reference
+ * until handed out or dropped by filemap_release_batch().
+ */
+static struct page *filemap_get_batched_page(struct address_space *mapping,
+		pgoff_t index, pgoff_t last_index,
+		struct pagevec *pvec, unsigned int *next)
+{
+	struct page *page;
+	unsigned int nr;
+
+	if (*next < pagevec_count(pvec)) {
+		page = pvec->pages[*next];
+		if (page->index == index && page->mapping == mapping) {
+			(*next)++;
+			return page;
+		}
+	}
+	filemap_release_batch(pvec, next);
+
+	nr = min_t(pgoff_t, last_index - index, PAGEVEC_SIZE);
+	if (nr <= 1)
+		return find_get_page(mapping, index);
+
+	nr = find_get_pages_contig(mapping, index, nr, pvec->pages);
+	if (!nr)
+		return NULL;
+	pvec->nr = nr;
+	*next = 1;
+	return pvec->pages[0];
+}
+
 /**
  * do_generic_file_read - generic file read routine
  * @filp:	the file to read
@@ -1091,8 +1229,11 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 	pgoff_t prev_index;
 	unsigned long offset;      /* offset into pagecache page */
 	unsigned int prev_offset;
+	struct pagevec pvec;	/* pages looked up ahead of the read */
+	unsigned int pv_next = 0;
 	int error;
 
+	pagevec_init(&pvec, 0);
 	index = *ppos >> PAGE_CACHE_SHIFT;
 	prev_index = ra->prev_pos >> PAGE_CACHE_SHIFT;
 	prev_offset = ra->prev_pos & (PAGE_CACHE_SIZE-1);
@@ -1107,12 +1248,14 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 
 		cond_resched();
 find_page:
-		page = find_get_page(mapping, index);
+		page = filemap_get_batched_page(mapping, index, last_index,
+						&pvec, &pv_next);
 		if (!page) {
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
-			page = find_get_page(mapping, index);
+			page = filemap_get_batched_page(mapping, index,
+						last_index, &pvec, &pv_next);
 			if (unlikely(page == NULL))
 				goto no_cached_page;
 		}
@@ -1289,6 +1432,8 @@ no_cached_page:
 	}
 
 out:
+	filemap_release_batch(&pvec, &pv_next);
+
 	ra->prev_pos = prev_index;
 	ra->prev_pos <<= PAGE_CACHE_SHIFT;
 	ra->prev_pos |= prev_offset;
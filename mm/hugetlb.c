@@ -450,6 +450,32 @@ static struct page *dequeue_huge_page_node(struct hstate *h, int nid)
 	return page;
 }
 
+static void hugetlb_rebalance(struct work_struct *work);
+static DECLARE_WORK(hugetlb_rebalance_work, hugetlb_rebalance);
+
+/*
+ * Account a huge page handed out at fault time as local or remote to the
+ * node the faulting task's mempolicy preferred.  Remote pages count as
+ * demand on the preferred node, for the rebalancer to act upon.
+ * Called with hugetlb_lock held.
+ */
+static void account_huge_page_locality(struct hstate *h, struct page *page,
+				       int preferred_nid)
+{
+	int nid = page_to_nid(page);
+
+	if (nid == preferred_nid) {
+		h->local_huge_pages_node[nid]++;
+		return;
+	}
+
+	h->remote_huge_pages_node[preferred_nid]++;
+	if (h->rebalance) {
+		h->demand_huge_pages_node[preferred_nid]++;
+		schedule_work(&hugetlb_rebalance_work);
+	}
+}
+
 static struct page *dequeue_huge_page_vma(struct hstate *h,
 				struct vm_area_struct *vma,
 				unsigned long address, int avoid_reserve)
@@ -460,6 +486,7 @@ static struct page *dequeue_huge_page_vma(struct hstate *h,
 	struct zonelist *zonelist;
 	struct zone *zone;
 	struct zoneref *z;
+	int preferred_nid = NUMA_NO_NODE;
 
 	get_mems_allowed();
 	zonelist = huge_zonelist(vma, address,
@@ -480,10 +507,14 @@ static struct page *dequeue_huge_page_vma(struct hstate *h,
 	for_each_zone_zonelist_nodemask(zone, z, zonelist,
 						MAX_NR_ZONES - 1, nodemask) {
 		if (cpuset_zone_allowed_softwall(zone, htlb_alloc_mask)) {
+			if (preferred_nid == NUMA_NO_NODE)
+				preferred_nid = zone_to_nid(zone);
 			page = dequeue_huge_page_node(h, zone_to_nid(zone));
 			if (page) {
 				if (!avoid_reserve)
 					decrement_hugepage_resv_vma(h, vma);
+				account_huge_page_locality(h, page,
+							   preferred_nid);
 				break;
 			}
 		}
@@ -1057,6 +1088,115 @@ static struct page *alloc_huge_page(struct vm_area_struct *vma,
 	return page;
 }
 
+/*
+ * Release one free persistent huge page on @nid back to the buddy
+ * allocator, if that can be done without eating into reserves.
+ * Called with hugetlb_lock held.
+ */
+static bool release_free_huge_page_node(struct hstate *h, int nid)
+{
+	struct page *page;
+
+	if (!h->free_huge_pages_node[nid] ||
+	    h->nr_huge_pages_node[nid] <= h->surplus_huge_pages_node[nid] ||
+	    h->free_huge_pages <= h->resv_huge_pages)
+		return false;
+
+	page = list_entry(h->hugepage_freelists[nid].next, struct page, lru);
+	list_del(&page->lru);
+	h->free_huge_pages--;
+	h->free_huge_pages_node[nid]--;
+	update_and_free_page(h, page);
+	return true;
+}
+
+/*
+ * Pick the node to give up a free huge page for @nid: the one with the
+ * most free persistent huge pages and no unmet demand of its own.
+ * Called with hugetlb_lock held.
+ */
+static int find_donor_node(struct hstate *h, int nid)
+{
+	unsigned int best = 0;
+	int donor = NUMA_NO_NODE;
+	int n;
+
+	for_each_node_state(n, N_HIGH_MEMORY) {
+		if (n == nid || h->demand_huge_pages_node[n])
+			continue;
+		if (h->nr_huge_pages_node[n] <= h->surplus_huge_pages_node[n])
+			continue;
+		if (h->free_huge_pages_node[n] > best) {
+			best = h->free_huge_pages_node[n];
+			donor = n;
+		}
+	}
+
+	return donor;
+}
+
+/*
+ * Shift free huge pages toward the nodes whose faults were served off-node
+ * since the last pass: allocate a fresh huge page on the node under demand,
+ * then release a free one from a donor node.  The pool size stays the same,
+ * only its spread across nodes changes.
+ */
+static void hugetlb_rebalance_hstate(struct hstate *h)
+{
+	int nid, donor;
+
+	if (h->order >= MAX_ORDER)
+		return;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		unsigned int demand;
+
+		spin_lock(&hugetlb_lock);
+		demand = h->demand_huge_pages_node[nid];
+		h->demand_huge_pages_node[nid] = 0;
+		spin_unlock(&hugetlb_lock);
+
+		while (demand--) {
+			struct page *page;
+
+			spin_lock(&hugetlb_lock);
+			if (h->surplus_huge_pages_node[nid])
+				donor = NUMA_NO_NODE;
+			else
+				donor = find_donor_node(h, nid);
+			spin_unlock(&hugetlb_lock);
+			if (donor == NUMA_NO_NODE)
+				break;
+
+			page = alloc_fresh_huge_page_node(h, nid);
+			if (!page)
+				break;
+			put_page(page); /* free it into the pool */
+
+			/*
+			 * If the donor was drained meanwhile, give the new
+			 * page back instead so the pool does not grow.
+			 */
+			spin_lock(&hugetlb_lock);
+			if (!release_free_huge_page_node(h, donor))
+				release_free_huge_page_node(h, nid);
+			spin_unlock(&hugetlb_lock);
+
+			cond_resched();
+		}
+	}
+}
+
+static void hugetlb_rebalance(struct work_struct *work)
+{
+	struct hstate *h;
+
+	for_each_hstate(h) {
+		if (h->rebalance)
+			hugetlb_rebalance_hstate(h);
+	}
+}
+
 int __weak alloc_bootmem_huge_page(struct hstate *h)
 {
 	struct huge_bootmem_page *m;
@@ -1527,14 +1667,79 @@ static ssize_t surplus_hugepages_show(struct kobject *kobj,
 }
 HSTATE_ATTR_RO(surplus_hugepages);
 
+static ssize_t hugepages_locality_show(struct kobject *kobj, char *buf,
+				       bool remote)
+{
+	struct hstate *h;
+	unsigned long *counts;
+	unsigned long nr = 0;
+	int nid;
+
+	h = kobj_to_hstate(kobj, &nid);
+	counts = remote ? h->remote_huge_pages_node : h->local_huge_pages_node;
+	if (nid == NUMA_NO_NODE) {
+		for_each_node_state(nid, N_HIGH_MEMORY)
+			nr += counts[nid];
+	} else
+		nr = counts[nid];
+
+	return sprintf(buf, "%lu\n", nr);
+}
+
+static ssize_t local_hugepages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return hugepages_locality_show(kobj, buf, false);
+}
+HSTATE_ATTR_RO(local_hugepages);
+
+static ssize_t remote_hugepages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return hugepages_locality_show(kobj, buf, true);
+}
+HSTATE_ATTR_RO(remote_hugepages);
+
+#ifdef CONFIG_NUMA
+static ssize_t rebalance_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	return sprintf(buf, "%u\n", h->rebalance);
+}
+
+static ssize_t rebalance_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int err;
+	unsigned long input;
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+
+	if (h->order >= MAX_ORDER)
+		return -EINVAL;
+
+	err = strict_strtoul(buf, 10, &input);
+	if (err || input > 1)
+		return -EINVAL;
+
+	h->rebalance = input;
+
+	return count;
+}
+HSTATE_ATTR(rebalance);
+#endif
+
 static struct attribute *hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&nr_overcommit_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&resv_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&local_hugepages_attr.attr,
+	&remote_hugepages_attr.attr,
 #ifdef CONFIG_NUMA
 	&nr_hugepages_mempolicy_attr.attr,
+	&rebalance_attr.attr,
 #endif
 	NULL,
 };
@@ -1601,6 +1806,8 @@ static struct attribute *per_node_hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&local_hugepages_attr.attr,
+	&remote_hugepages_attr.attr,
 	NULL,
 };
 
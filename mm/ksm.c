@@ -23,7 +23,6 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -86,12 +85,20 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @pages_merged: pages of this mm merged during the current full scan
+ * @full_scans: number of full scans of this mm completed (saturating)
+ * @backoff: number of full scans to skip after the next one
+ * @skip_scans: full scans still to be skipped before this mm is rescanned
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned int pages_merged;
+	unsigned int full_scans;
+	unsigned int backoff;
+	unsigned int skip_scans;
 };
 
 /**
@@ -189,6 +196,13 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * Most full scans an unproductive mm may be skipped for in a row.  Bounded
+ * so that the seqnr stamped into unstable rmap_items cannot wrap around.
+ */
+#define KSM_MAX_SKIP_SCANS	64
+static unsigned int ksm_max_skip_scans = 8;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -554,7 +568,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		 * than left over from before.
 		 */
 		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
-		BUG_ON(age > 1);
+		BUG_ON(age > KSM_MAX_SKIP_SCANS + 1);
 		if (!age)
 			rb_erase(&rmap_item->node, &root_unstable_tree);
 
@@ -669,13 +683,30 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum only has to notice that a page changed between two scans:
+ * pages are always compared in full before being merged.  So rather than
+ * jhash, fold the page a word at a time into two independent multiplicative
+ * lanes, which keeps the CPU busy on loads instead of on mixing rounds.
+ */
+#define KSM_CHECKSUM_MULT	0x9e3779b97f4a7c15ULL
+
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	u64 *addr = kmap_atomic(page, KM_USER0);
+	u64 a = 17, b = 0;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(u64); i += 2) {
+		a = (a ^ addr[i]) * KSM_CHECKSUM_MULT;
+		a ^= a >> 29;
+		b = (b ^ addr[i + 1]) * KSM_CHECKSUM_MULT;
+		b ^= b >> 29;
+	}
 	kunmap_atomic(addr, KM_USER0);
-	return checksum;
+
+	a ^= (b << 17) | (b >> 47);
+	return (u32)(a >> 32) ^ (u32)a;
 }
 
 static int memcmp_pages(struct page *page1, struct page *page2)
@@ -1191,6 +1222,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			ksm_scan.mm_slot->pages_merged++;
 		}
 		put_page(kpage);
 		return;
@@ -1227,6 +1259,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				ksm_scan.mm_slot->pages_merged++;
 			}
 			unlock_page(kpage);
 
@@ -1272,6 +1305,51 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * An mm that completed a full scan without merging anything is skipped
+ * for an exponentially growing number of subsequent full scans, up to
+ * ksm_max_skip_scans; one that merged something is rescanned every time.
+ * Each mm is scanned twice before it can be backed off, since it takes
+ * two looks at a page for its checksum to qualify it for merging.
+ *
+ * Called with ksm_mmlist_lock held.
+ */
+static void ksm_update_backoff(struct mm_slot *slot)
+{
+	if (slot->full_scans < 2)
+		slot->full_scans++;
+
+	if (slot->pages_merged || slot->full_scans < 2)
+		slot->backoff = 0;
+	else if (!slot->backoff)
+		slot->backoff = 1;
+	else
+		slot->backoff *= 2;
+
+	slot->backoff = min(slot->backoff, ksm_max_skip_scans);
+	slot->skip_scans = slot->backoff;
+	slot->pages_merged = 0;
+}
+
+/*
+ * Find the next mm_slot after @slot due for scanning, charging one skipped
+ * full scan to each backed-off slot passed over.  An exiting mm is never
+ * passed over, so that its rmap_items are torn down promptly.  Returns
+ * &ksm_mm_head at the end of the list.
+ *
+ * Called with ksm_mmlist_lock held.
+ */
+static struct mm_slot *ksm_next_mm_slot(struct mm_slot *slot)
+{
+	for (;;) {
+		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
+		if (slot == &ksm_mm_head || !slot->skip_scans ||
+		    ksm_test_exit(slot->mm))
+			return slot;
+		slot->skip_scans--;
+	}
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1299,12 +1377,13 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		root_unstable_tree = RB_ROOT;
 
 		spin_lock(&ksm_mmlist_lock);
-		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
+		slot = ksm_next_mm_slot(slot);
 		ksm_scan.mm_slot = slot;
 		spin_unlock(&ksm_mmlist_lock);
 		/*
 		 * Although we tested list_empty() above, a racing __ksm_exit
-		 * of the last mm on the list may have removed it since then.
+		 * of the last mm on the list may have removed it since then;
+		 * or every mm on it may be backed off for this full scan.
 		 */
 		if (slot == &ksm_mm_head)
 			return NULL;
@@ -1369,8 +1448,8 @@ next_mm:
 	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
 
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
-						struct mm_slot, mm_list);
+	ksm_update_backoff(slot);
+	ksm_scan.mm_slot = ksm_next_mm_slot(slot);
 	if (ksm_scan.address == 0) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
@@ -1452,6 +1531,19 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+static void ksm_reset_backoff(struct mm_struct *mm)
+{
+	struct mm_slot *mm_slot;
+
+	spin_lock(&ksm_mmlist_lock);
+	mm_slot = get_mm_slot(mm);
+	if (mm_slot) {
+		mm_slot->backoff = 0;
+		mm_slot->skip_scans = 0;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1460,10 +1552,19 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
+		/*
+		 * Advising an area mergeable again asks for the mm to be
+		 * rescanned promptly, even if recent scans merged nothing.
+		 */
+		if (*vm_flags & VM_MERGEABLE) {
+			ksm_reset_backoff(mm);
+			return 0;
+		}
+
 		/*
 		 * Be somewhat over-protective for now!
 		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
+		if (*vm_flags & (VM_SHARED    | VM_MAYSHARE   |
 				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
 				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
 				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
@@ -1872,6 +1973,29 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t max_skip_scans_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_max_skip_scans);
+}
+
+static ssize_t max_skip_scans_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	int err;
+	unsigned long scans;
+
+	err = strict_strtoul(buf, 10, &scans);
+	if (err || scans > KSM_MAX_SKIP_SCANS)
+		return -EINVAL;
+
+	ksm_max_skip_scans = scans;
+
+	return count;
+}
+KSM_ATTR(max_skip_scans);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1969,6 +2093,7 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&max_skip_scans_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
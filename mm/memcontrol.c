@@ -49,6 +49,8 @@
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -202,6 +204,16 @@ struct mem_cgroup_eventfd_list {
 	struct eventfd_ctx *eventfd;
 };
 
+/* for stall notification */
+struct mem_cgroup_stall_event {
+	struct list_head list;
+	struct eventfd_ctx *eventfd;
+	unsigned int threshold;		/* percent */
+};
+
+/* Length of the window over which the stall percentage is sampled */
+#define MEM_CGROUP_STALL_WINDOW	NSEC_PER_SEC
+
 static void mem_cgroup_threshold(struct mem_cgroup *mem);
 static void mem_cgroup_oom_notify(struct mem_cgroup *mem);
 
@@ -268,6 +280,24 @@ struct mem_cgroup {
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
+	/*
+	 * Memory stall accounting, see mem_cgroup_stall_begin(). All times
+	 * are in nanoseconds. "some" time is time during which at least one
+	 * task of the group was stalled, "total" time is summed over tasks.
+	 */
+	spinlock_t	stall_lock;
+	unsigned int	nr_stalled;
+	unsigned int	stall_percent;	/* "some" share of the last window */
+	u64		stall_start;	/* nr_stalled became non-zero */
+	u64		stall_some;
+	u64		stall_total;
+	u64		stall_window_start;
+	u64		stall_window_some;
+	/* closes windows while tasks are stalled */
+	struct delayed_work stall_work;
+	/* For stall notifier event fd */
+	struct list_head stall_notify;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -2211,6 +2241,7 @@ static int mem_cgroup_do_charge(struct mem_cgroup *mem, gfp_t gfp_mask,
 	unsigned long csize = nr_pages * PAGE_SIZE;
 	struct mem_cgroup *mem_over_limit;
 	struct res_counter *fail_res;
+	struct mem_cgroup_stall stall;
 	unsigned long flags = 0;
 	int ret;
 
@@ -2241,8 +2272,10 @@ static int mem_cgroup_do_charge(struct mem_cgroup *mem, gfp_t gfp_mask,
 	if (!(gfp_mask & __GFP_WAIT))
 		return CHARGE_WOULDBLOCK;
 
+	mem_cgroup_stall_begin(&stall);
 	ret = mem_cgroup_hierarchical_reclaim(mem_over_limit, NULL,
 					      gfp_mask, flags, NULL);
+	mem_cgroup_stall_end(&stall);
 	if (mem_cgroup_margin(mem_over_limit) >= nr_pages)
 		return CHARGE_RETRY;
 	/*
@@ -4612,6 +4645,191 @@ static void mem_cgroup_oom_unregister_event(struct cgroup *cgrp,
 	mutex_unlock(&memcg_oom_mutex);
 }
 
+static u64 mem_cgroup_stall_some(struct mem_cgroup *mem, u64 now)
+{
+	u64 some = mem->stall_some;
+
+	if (mem->nr_stalled)
+		some += now - mem->stall_start;
+	return some;
+}
+
+/*
+ * Close the current sampling window if it has run its course and notify
+ * the listeners whose threshold the stall percentage crossed upwards.
+ * Called with stall_lock held.
+ */
+static void mem_cgroup_stall_window(struct mem_cgroup *mem, u64 now)
+{
+	struct mem_cgroup_stall_event *ev;
+	unsigned int old = mem->stall_percent;
+	u64 elapsed = now - mem->stall_window_start;
+	u64 some;
+
+	if (elapsed < MEM_CGROUP_STALL_WINDOW)
+		return;
+
+	some = mem_cgroup_stall_some(mem, now);
+	mem->stall_percent = div64_u64((some - mem->stall_window_some) * 100,
+				       elapsed);
+	mem->stall_window_start = now;
+	mem->stall_window_some = some;
+
+	list_for_each_entry(ev, &mem->stall_notify, list)
+		if (old < ev->threshold && mem->stall_percent >= ev->threshold)
+			eventfd_signal(ev->eventfd, 1);
+}
+
+/*
+ * Make sure the current window gets closed on time even if no stall
+ * begins or ends meanwhile, e.g. when all tasks sit in one long reclaim.
+ * Called with stall_lock held and the window just updated.
+ */
+static void mem_cgroup_stall_arm(struct mem_cgroup *mem, u64 now)
+{
+	u64 left = mem->stall_window_start + MEM_CGROUP_STALL_WINDOW - now;
+
+	schedule_delayed_work(&mem->stall_work, nsecs_to_jiffies(left) + 1);
+}
+
+static void mem_cgroup_stall_work(struct work_struct *work)
+{
+	struct mem_cgroup *mem = container_of(to_delayed_work(work),
+					      struct mem_cgroup, stall_work);
+	u64 now;
+
+	spin_lock(&mem->stall_lock);
+	now = ktime_to_ns(ktime_get());
+	mem_cgroup_stall_window(mem, now);
+	if (mem->nr_stalled)
+		mem_cgroup_stall_arm(mem, now);
+	spin_unlock(&mem->stall_lock);
+}
+
+/**
+ * mem_cgroup_stall_begin - note that the current task waits for memory
+ * @stall: per-call state to be passed to mem_cgroup_stall_end()
+ *
+ * The wait is accounted to the memory cgroup of current->mm and, with
+ * hierarchy enabled, to all of its ancestors.
+ */
+void mem_cgroup_stall_begin(struct mem_cgroup_stall *stall)
+{
+	struct mem_cgroup *mem, *iter;
+	u64 now;
+
+	stall->mem = NULL;
+	if (mem_cgroup_disabled())
+		return;
+	mem = try_get_mem_cgroup_from_mm(current->mm);
+	if (!mem)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	for (iter = mem; iter; iter = parent_mem_cgroup(iter)) {
+		spin_lock(&iter->stall_lock);
+		mem_cgroup_stall_window(iter, now);
+		if (!iter->nr_stalled++) {
+			iter->stall_start = now;
+			mem_cgroup_stall_arm(iter, now);
+		}
+		spin_unlock(&iter->stall_lock);
+	}
+	stall->mem = mem;
+	stall->start = now;
+}
+
+/**
+ * mem_cgroup_stall_end - the wait started by mem_cgroup_stall_begin() is over
+ * @stall: state filled in by mem_cgroup_stall_begin()
+ */
+void mem_cgroup_stall_end(struct mem_cgroup_stall *stall)
+{
+	struct mem_cgroup *mem = stall->mem, *iter;
+	u64 now;
+
+	if (!mem)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	for (iter = mem; iter; iter = parent_mem_cgroup(iter)) {
+		spin_lock(&iter->stall_lock);
+		if (!--iter->nr_stalled)
+			iter->stall_some += now - iter->stall_start;
+		iter->stall_total += now - stall->start;
+		mem_cgroup_stall_window(iter, now);
+		spin_unlock(&iter->stall_lock);
+	}
+	css_put(&mem->css);
+	stall->mem = NULL;
+}
+
+static int mem_cgroup_pressure_read(struct cgroup *cgrp,
+	struct cftype *cft, struct cgroup_map_cb *cb)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	unsigned int percent;
+	u64 now, some, total;
+
+	spin_lock(&mem->stall_lock);
+	now = ktime_to_ns(ktime_get());
+	mem_cgroup_stall_window(mem, now);
+	percent = mem->stall_percent;
+	some = mem_cgroup_stall_some(mem, now);
+	total = mem->stall_total;
+	spin_unlock(&mem->stall_lock);
+
+	cb->fill(cb, "some_percent", percent);
+	cb->fill(cb, "some_usec", div_u64(some, NSEC_PER_USEC));
+	cb->fill(cb, "total_usec", div_u64(total, NSEC_PER_USEC));
+	return 0;
+}
+
+static int mem_cgroup_pressure_register_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd, const char *args)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_stall_event *event;
+	unsigned long threshold;
+	int ret;
+
+	ret = kstrtoul(args, 10, &threshold);
+	if (ret)
+		return ret;
+	if (!threshold || threshold > 100)
+		return -EINVAL;
+
+	event = kmalloc(sizeof(*event), GFP_KERNEL);
+	if (!event)
+		return -ENOMEM;
+	event->eventfd = eventfd;
+	event->threshold = threshold;
+
+	spin_lock(&mem->stall_lock);
+	list_add(&event->list, &mem->stall_notify);
+	spin_unlock(&mem->stall_lock);
+
+	return 0;
+}
+
+static void mem_cgroup_pressure_unregister_event(struct cgroup *cgrp,
+	struct cftype *cft, struct eventfd_ctx *eventfd)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_stall_event *ev, *tmp;
+	LIST_HEAD(free);
+
+	spin_lock(&mem->stall_lock);
+	list_for_each_entry_safe(ev, tmp, &mem->stall_notify, list) {
+		if (ev->eventfd == eventfd)
+			list_move(&ev->list, &free);
+	}
+	spin_unlock(&mem->stall_lock);
+
+	list_for_each_entry_safe(ev, tmp, &free, list)
+		kfree(ev);
+}
+
 static int mem_cgroup_oom_control_read(struct cgroup *cgrp,
 	struct cftype *cft,  struct cgroup_map_cb *cb)
 {
@@ -4731,6 +4949,12 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "pressure",
+		.read_map = mem_cgroup_pressure_read,
+		.register_event = mem_cgroup_pressure_register_event,
+		.unregister_event = mem_cgroup_pressure_unregister_event,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -4995,6 +5219,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_child = 0;
 	mem->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&mem->oom_notify);
+	spin_lock_init(&mem->stall_lock);
+	INIT_LIST_HEAD(&mem->stall_notify);
+	mem->stall_window_start = ktime_to_ns(ktime_get());
+	INIT_DELAYED_WORK(&mem->stall_work, mem_cgroup_stall_work);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -5021,6 +5249,8 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	/* No stalls are left to re-arm it once the cgroup is removed */
+	cancel_delayed_work_sync(&mem->stall_work);
 	mem_cgroup_put(mem);
 }
 
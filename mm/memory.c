@@ -205,6 +205,9 @@ static int tlb_next_batch(struct mmu_gather *tlb)
 		return 1;
 	}
 
+	if (tlb->batch_count == MAX_GATHER_BATCH_COUNT)
+		return 0;
+
 	batch = (void *)__get_free_pages(GFP_NOWAIT | __GFP_NOWARN, 0);
 	if (!batch)
 		return 0;
@@ -213,6 +216,7 @@ static int tlb_next_batch(struct mmu_gather *tlb)
 	batch->nr   = 0;
 	batch->max  = MAX_GATHER_BATCH;
 
+	tlb->batch_count++;
 	tlb->active->next = batch;
 	tlb->active = batch;
 
@@ -235,6 +239,7 @@ void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm, bool fullmm)
 	tlb->local.nr   = 0;
 	tlb->local.max  = ARRAY_SIZE(tlb->__pages);
 	tlb->active     = &tlb->local;
+	tlb->batch_count = 0;
 
 #ifdef CONFIG_HAVE_RCU_TABLE_FREE
 	tlb->batch = NULL;
@@ -894,9 +899,11 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 
 	/*
 	 * If it's a COW mapping, write protect it both
-	 * in the parent and the child
+	 * in the parent and the child.  A pte which is already read-only
+	 * (not written since the previous fork, for instance) needs no
+	 * atomic update of the parent's entry.
 	 */
-	if (is_cow_mapping(vm_flags)) {
+	if (is_cow_mapping(vm_flags) && pte_write(pte)) {
 		ptep_set_wrprotect(src_mm, addr, src_pte);
 		pte = pte_wrprotect(pte);
 	}
@@ -2863,6 +2870,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	pte_t pte;
 	int locked;
 	struct mem_cgroup *ptr;
+	struct mem_cgroup_stall stall;
 	int exclusive = 0;
 	int ret = 0;
 
@@ -2882,6 +2890,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
+	mem_cgroup_stall_begin(&stall);
 	page = lookup_swap_cache(entry);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
@@ -2896,6 +2905,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			if (likely(pte_same(*page_table, orig_pte)))
 				ret = VM_FAULT_OOM;
 			delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+			mem_cgroup_stall_end(&stall);
 			goto unlock;
 		}
 
@@ -2910,11 +2920,13 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		 */
 		ret = VM_FAULT_HWPOISON;
 		delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+		mem_cgroup_stall_end(&stall);
 		goto out_release;
 	}
 
 	locked = lock_page_or_retry(page, mm, flags);
 	delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+	mem_cgroup_stall_end(&stall);
 	if (!locked) {
 		ret |= VM_FAULT_RETRY;
 		goto out_release;
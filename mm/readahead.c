@@ -110,8 +110,9 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
 	struct blk_plug plug;
+	struct pagevec pvec;
 	unsigned page_idx;
-	int ret;
+	int ret, i;
 
 	blk_start_plug(&plug);
 
@@ -122,14 +123,21 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
+	pagevec_init(&pvec, 0);
 	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
 		struct page *page = list_to_page(pages);
 		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
+		if (pagevec_add(&pvec, page) && page_idx + 1 < nr_pages)
+			continue;
+
+		add_to_page_cache_lru_vec(&pvec, mapping, GFP_KERNEL);
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			page = pvec.pages[i];
+			if (page->mapping == mapping)
+				mapping->a_ops->readpage(filp, page);
+			page_cache_release(page);
 		}
-		page_cache_release(page);
+		pagevec_reinit(&pvec);
 	}
 	ret = 0;
 
@@ -390,7 +398,50 @@ static int try_context_readahead(struct address_space *mapping,
 }
 
 /*
- * A minimal readahead algorithm for trivial sequential/random reads.
+ * Strided reads skip a fixed number of pages between requests of a fixed
+ * size, leaving no trace that the sequential or the context based logic
+ * could pick up.  Two consecutive misses landing the same distance past the
+ * end of the previous read establish the stride: read the current request
+ * together with as many of the following strides as fit in the window.
+ */
+static unsigned long try_stride_readahead(struct address_space *mapping,
+					  struct file_ra_state *ra,
+					  struct file *filp, pgoff_t offset,
+					  unsigned long req_size,
+					  unsigned long max)
+{
+	pgoff_t prev = ra->prev_pos >> PAGE_CACHE_SHIFT;
+	unsigned long gap, stride, nr, i;
+	unsigned long actual = 0;
+	struct blk_plug plug;
+
+	if (ra->prev_pos == -1 || offset <= prev || offset - prev > max * 64) {
+		ra->stride_gap = 0;
+		return 0;
+	}
+
+	gap = offset - prev;
+	if (gap != ra->stride_gap) {
+		ra->stride_gap = gap;
+		return 0;
+	}
+
+	nr = max / req_size;
+	if (nr < 2)
+		return 0;
+
+	stride = gap + req_size - 1;
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++)
+		actual += __do_page_cache_readahead(mapping, filp,
+					offset + i * stride, req_size, 0);
+	blk_finish_plug(&plug);
+
+	return actual;
+}
+
+/*
+ * A minimal readahead algorithm for trivial sequential/strided/random reads.
  */
 static unsigned long
 ondemand_readahead(struct address_space *mapping,
@@ -399,6 +450,7 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long ret;
 
 	/*
 	 * start of file
@@ -461,6 +513,14 @@ ondemand_readahead(struct address_space *mapping,
 	if (try_context_readahead(mapping, ra, offset, req_size, max))
 		goto readit;
 
+	/*
+	 * Strided read: read ahead along the stride, and leave the
+	 * sequential readahead state alone.
+	 */
+	ret = try_stride_readahead(mapping, ra, filp, offset, req_size, max);
+	if (ret)
+		return ret;
+
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
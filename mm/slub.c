@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/debugfs.h>
 #include <linux/kmemcheck.h>
 #include <linux/cpu.h>
 #include <linux/cpuset.h>
@@ -1422,10 +1423,16 @@ static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
 
 /*
  * Try to allocate a partial slab from a specific node.
+ *
+ * While holding the list_lock, also take up to s->cpu_partial further
+ * slabs off the node list in the same pass. Those are frozen and parked
+ * on the per cpu partial list, so that the next few refills of the cpu
+ * slab do not need to take the list_lock at all.
  */
-static struct page *get_partial_node(struct kmem_cache_node *n)
+static struct page *get_partial_node(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct kmem_cache_cpu *c)
 {
-	struct page *page;
+	struct page *page, *page2, *first = NULL;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1437,19 +1444,34 @@ static struct page *get_partial_node(struct kmem_cache_node *n)
 		return NULL;
 
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (lock_and_freeze_slab(n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, page2, &n->partial, lru) {
+		if (!lock_and_freeze_slab(n, page))
+			continue;
+
+		if (!first) {
+			/* The new cpu slab: returned locked */
+			first = page;
+		} else {
+			slab_unlock(page);
+			list_add_tail(&page->lru, &c->partial);
+			c->nr_partial++;
+			stat(s, CPU_PARTIAL_NODE);
+		}
+
+		/* Leave some partial slabs on the node for other cpus */
+		if (c->nr_partial >= s->cpu_partial ||
+				n->nr_partial <= s->min_partial)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return first;
 }
 
 /*
  * Get a page from somewhere. Search in increasing NUMA distances.
  */
-static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
+static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags,
+		struct kmem_cache_cpu *c)
 {
 #ifdef CONFIG_NUMA
 	struct zonelist *zonelist;
@@ -1489,7 +1511,7 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 
 		if (n && cpuset_zone_allowed_hardwall(zone, flags) &&
 				n->nr_partial > s->min_partial) {
-			page = get_partial_node(n);
+			page = get_partial_node(s, n, c);
 			if (page) {
 				put_mems_allowed();
 				return page;
@@ -1504,16 +1526,42 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 /*
  * Get a partial page, lock it and return it.
  */
-static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node)
+static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node,
+		struct kmem_cache_cpu *c)
 {
 	struct page *page;
 	int searchnode = (node == NUMA_NO_NODE) ? numa_node_id() : node;
 
-	page = get_partial_node(get_node(s, searchnode));
+	page = get_partial_node(s, get_node(s, searchnode), c);
 	if (page || node != NUMA_NO_NODE)
 		return page;
 
-	return get_any_partial(s, flags);
+	return get_any_partial(s, flags, c);
+}
+
+/*
+ * Take a slab off the per cpu partial list, lock it and return it.
+ *
+ * The slabs on that list are frozen, so nothing but remote frees can
+ * touch them; those only ever add objects to page->freelist.
+ *
+ * Must be called with interrupts disabled.
+ */
+static struct page *get_cpu_partial(struct kmem_cache_cpu *c, int node)
+{
+	struct page *page;
+
+	if (list_empty(&c->partial))
+		return NULL;
+
+	page = list_first_entry(&c->partial, struct page, lru);
+	if (node != NUMA_NO_NODE && page_to_nid(page) != node)
+		return NULL;
+
+	list_del(&page->lru);
+	c->nr_partial--;
+	slab_lock(page);
+	return page;
 }
 
 /*
@@ -1626,8 +1674,12 @@ void init_kmem_cache_cpus(struct kmem_cache *s)
 {
 	int cpu;
 
-	for_each_possible_cpu(cpu)
-		per_cpu_ptr(s->cpu_slab, cpu)->tid = init_tid(cpu);
+	for_each_possible_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+		c->tid = init_tid(cpu);
+		INIT_LIST_HEAD(&c->partial);
+	}
 }
 /*
  * Remove the cpu slab
@@ -1671,6 +1723,23 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+/*
+ * Return all slabs on the per cpu partial list to the node lists (or to
+ * the page allocator if they became empty in the meantime).
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, &c->partial, lru) {
+		list_del(&page->lru);
+		slab_lock(page);
+		unfreeze_slab(s, page, 1);
+		stat(s, CPU_PARTIAL_DRAIN);
+	}
+	c->nr_partial = 0;
+}
+
 /*
  * Flush cpu slab.
  *
@@ -1680,8 +1749,12 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
-		flush_slab(s, c);
+	if (likely(c)) {
+		if (c->page)
+			flush_slab(s, c);
+
+		unfreeze_partials(s, c);
+	}
 }
 
 static void flush_cpu_slab(void *d)
@@ -1841,7 +1914,15 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
-	page = get_partial(s, gfpflags, node);
+	page = get_cpu_partial(c, node);
+	if (page) {
+		stat(s, CPU_PARTIAL_ALLOC);
+		c->node = page_to_nid(page);
+		c->page = page;
+		goto load_freelist;
+	}
+
+	page = get_partial(s, gfpflags, node, c);
 	if (page) {
 		stat(s, ALLOC_FROM_PARTIAL);
 		c->node = page_to_nid(page);
@@ -2594,6 +2675,24 @@ static int kmem_cache_open(struct kmem_cache *s,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * The number of partial slabs a cpu grabs in one go when it runs
+	 * out of objects. Smaller objects turn over slabs more quickly, so
+	 * keep more of them around. Debugging needs every slab to go
+	 * through the node lists, so disable the per cpu lists then.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 8;
+	else
+		s->cpu_partial = 16;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -3989,6 +4088,12 @@ static ssize_t show_slab_objects(struct kmem_cache *s,
 				total += x;
 				nodes[c->node] += x;
 			}
+			if (!(flags & (SO_TOTAL | SO_OBJECTS))) {
+				/* Racy, but only a statistic */
+				x = c->nr_partial;
+				total += x;
+				nodes[c->node] += x;
+			}
 			per_cpu[c->node]++;
 		}
 	}
@@ -4140,6 +4245,31 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs && kmem_cache_debug(s))
+		return -EINVAL;
+	if (slabs > INT_MAX)
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -4486,6 +4616,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4494,6 +4627,7 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -4543,6 +4677,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_node_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -4899,3 +5036,121 @@ static int __init slab_proc_init(void)
 }
 module_init(slab_proc_init);
 #endif /* CONFIG_SLABINFO */
+
+#if defined(CONFIG_SLUB_STATS) && defined(CONFIG_DEBUG_FS)
+/*
+ * All per cpu statistics of all caches in one file, so that a monitoring
+ * tool can sample them without opening one sysfs attribute per cache and
+ * statistic. The counters themselves are read without synchronization
+ * against the allocator.
+ */
+static const char * const slub_stat_names[] = {
+	[ALLOC_FASTPATH]		= "alloc_fastpath",
+	[ALLOC_SLOWPATH]		= "alloc_slowpath",
+	[FREE_FASTPATH]			= "free_fastpath",
+	[FREE_SLOWPATH]			= "free_slowpath",
+	[FREE_FROZEN]			= "free_frozen",
+	[FREE_ADD_PARTIAL]		= "free_add_partial",
+	[FREE_REMOVE_PARTIAL]		= "free_remove_partial",
+	[ALLOC_FROM_PARTIAL]		= "alloc_from_partial",
+	[ALLOC_SLAB]			= "alloc_slab",
+	[ALLOC_REFILL]			= "alloc_refill",
+	[FREE_SLAB]			= "free_slab",
+	[CPUSLAB_FLUSH]			= "cpuslab_flush",
+	[DEACTIVATE_FULL]		= "deactivate_full",
+	[DEACTIVATE_EMPTY]		= "deactivate_empty",
+	[DEACTIVATE_TO_HEAD]		= "deactivate_to_head",
+	[DEACTIVATE_TO_TAIL]		= "deactivate_to_tail",
+	[DEACTIVATE_REMOTE_FREES]	= "deactivate_remote_frees",
+	[ORDER_FALLBACK]		= "order_fallback",
+	[CMPXCHG_DOUBLE_CPU_FAIL]	= "cmpxchg_double_cpu_fail",
+	[CPU_PARTIAL_ALLOC]		= "cpu_partial_alloc",
+	[CPU_PARTIAL_NODE]		= "cpu_partial_node",
+	[CPU_PARTIAL_DRAIN]		= "cpu_partial_drain",
+};
+
+static void *slub_stats_start(struct seq_file *m, loff_t *pos)
+{
+	down_read(&slub_lock);
+	if (!*pos)
+		return SEQ_START_TOKEN;
+	return seq_list_start(&slab_caches, *pos - 1);
+}
+
+static void *slub_stats_next(struct seq_file *m, void *p, loff_t *pos)
+{
+	if (p == SEQ_START_TOKEN)
+		p = &slab_caches;
+	return seq_list_next(p, &slab_caches, pos);
+}
+
+static void slub_stats_stop(struct seq_file *m, void *p)
+{
+	up_read(&slub_lock);
+}
+
+static int slub_stats_show(struct seq_file *m, void *p)
+{
+	struct kmem_cache *s;
+	int cpu, si;
+
+	if (p == SEQ_START_TOKEN) {
+		seq_puts(m, "# name cpu");
+		for (si = 0; si < NR_SLUB_STAT_ITEMS; si++)
+			seq_printf(m, " %s", slub_stat_names[si]);
+		seq_putc(m, '\n');
+		return 0;
+	}
+
+	s = list_entry(p, struct kmem_cache, list);
+	for_each_online_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+		unsigned stat[NR_SLUB_STAT_ITEMS];
+		unsigned any = 0;
+
+		for (si = 0; si < NR_SLUB_STAT_ITEMS; si++) {
+			stat[si] = ACCESS_ONCE(c->stat[si]);
+			any |= stat[si];
+		}
+		/* Keep the output proportional to the active caches */
+		if (!any)
+			continue;
+
+		seq_printf(m, "%s %d", s->name, cpu);
+		for (si = 0; si < NR_SLUB_STAT_ITEMS; si++)
+			seq_printf(m, " %u", stat[si]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static const struct seq_operations slub_stats_op = {
+	.start = slub_stats_start,
+	.next = slub_stats_next,
+	.stop = slub_stats_stop,
+	.show = slub_stats_show,
+};
+
+static int slub_stats_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &slub_stats_op);
+}
+
+static const struct file_operations slub_stats_fops = {
+	.open		= slub_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init slub_stats_debugfs_init(void)
+{
+	BUILD_BUG_ON(ARRAY_SIZE(slub_stat_names) != NR_SLUB_STAT_ITEMS);
+
+	if (!debugfs_create_file("slub_stats", S_IRUGO, NULL, NULL,
+				 &slub_stats_fops))
+		pr_warning("Failed to create the debugfs slub_stats file\n");
+	return 0;
+}
+late_initcall(slub_stats_debugfs_init);
+#endif
@@ -254,6 +254,7 @@ struct vmap_area {
 	unsigned long va_end;
 	unsigned long flags;
 	struct rb_node rb_node;		/* address sorted rbtree */
+	unsigned long subtree_max_gap;	/* largest hole below any area in subtree */
 	struct list_head list;		/* address sorted list */
 	struct list_head purge_list;	/* "lazy purge" list */
 	void *private;
@@ -264,11 +265,9 @@ static DEFINE_SPINLOCK(vmap_area_lock);
 static LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 
-/* The vmap cache globals are protected by vmap_area_lock */
-static struct rb_node *free_vmap_cache;
-static unsigned long cached_hole_size;
-static unsigned long cached_vstart;
-static unsigned long cached_align;
+/* Lazily freed areas awaiting a purge, protected by vmap_purge_lock */
+static DEFINE_SPINLOCK(vmap_purge_lock);
+static LIST_HEAD(vmap_purge_list);
 
 static unsigned long vmap_area_pcpu_hole;
 
@@ -291,6 +290,73 @@ static struct vmap_area *__find_vmap_area(unsigned long addr)
 	return NULL;
 }
 
+/*
+ * The rbtree of busy areas is augmented with the size of the largest hole
+ * found below any area in each subtree, where the hole below an area is
+ * the space between it and its predecessor in address order.  This lets
+ * alloc_vmap_area() descend straight to the lowest hole that can fit a
+ * request rather than walking the areas one by one.
+ */
+static unsigned long va_hole(struct vmap_area *va)
+{
+	struct vmap_area *prev;
+
+	if (va->list.prev == &vmap_area_list)
+		return va->va_start;
+
+	prev = list_entry(va->list.prev, struct vmap_area, list);
+	return va->va_start - prev->va_end;
+}
+
+static unsigned long va_hole_start(struct vmap_area *va)
+{
+	return va->va_start - va_hole(va);
+}
+
+static unsigned long get_subtree_max_gap(struct rb_node *node)
+{
+	if (!node)
+		return 0;
+	return rb_entry(node, struct vmap_area, rb_node)->subtree_max_gap;
+}
+
+static void vmap_area_augment_cb(struct rb_node *node, void *unused)
+{
+	struct vmap_area *va;
+	unsigned long max_gap, child_max_gap;
+
+	if (!node)
+		return;
+
+	va = rb_entry(node, struct vmap_area, rb_node);
+	max_gap = va_hole(va);
+
+	child_max_gap = get_subtree_max_gap(node->rb_left);
+	if (child_max_gap > max_gap)
+		max_gap = child_max_gap;
+
+	child_max_gap = get_subtree_max_gap(node->rb_right);
+	if (child_max_gap > max_gap)
+		max_gap = child_max_gap;
+
+	va->subtree_max_gap = max_gap;
+}
+
+/*
+ * The hole below the area following @va in address order has changed:
+ * propagate that up the tree.
+ */
+static void vmap_area_augment_next(struct list_head *next)
+{
+	struct vmap_area *va;
+
+	if (next == &vmap_area_list)
+		return;
+
+	va = list_entry(next, struct vmap_area, list);
+	rb_augment_erase_end(&va->rb_node, vmap_area_augment_cb, NULL);
+}
+
 static void __insert_vmap_area(struct vmap_area *va)
 {
 	struct rb_node **p = &vmap_area_root.rb_node;
@@ -321,6 +387,81 @@ static void __insert_vmap_area(struct vmap_area *va)
 		list_add_rcu(&va->list, &prev->list);
 	} else
 		list_add_rcu(&va->list, &vmap_area_list);
+
+	rb_augment_insert(&va->rb_node, vmap_area_augment_cb, NULL);
+	vmap_area_augment_next(va->list.next);
+}
+
+/*
+ * Find the lowest address at which @size bytes aligned to @align fit
+ * between @vstart and @vend, or return 0 if there is no such hole.
+ *
+ * The tree is walked in address order, skipping any subtree whose largest
+ * hole is smaller than @size.  Alignment can still make a hole of at least
+ * @size unusable, in which case the walk just moves on to the next one.
+ */
+static unsigned long __find_vmap_hole(unsigned long size, unsigned long align,
+				      unsigned long vstart, unsigned long vend)
+{
+	struct rb_node *n = vmap_area_root.rb_node;
+	struct rb_node *prev;
+	struct vmap_area *va;
+	unsigned long addr;
+
+	if (!n || get_subtree_max_gap(n) < size)
+		goto check_highest;
+
+	for (;;) {
+		va = rb_entry(n, struct vmap_area, rb_node);
+
+		/* Holes in the left subtree all end at or below va_start */
+		if (va->va_start >= vstart + size &&
+		    get_subtree_max_gap(n->rb_left) >= size) {
+			n = n->rb_left;
+			continue;
+		}
+
+check_current:
+		if (va_hole_start(va) >= vend)
+			return 0;
+		addr = ALIGN(max(va_hole_start(va), vstart), align);
+		if (addr >= vstart && addr + size > addr &&
+		    addr + size <= va->va_start)
+			goto found;
+
+		if (get_subtree_max_gap(n->rb_right) >= size) {
+			n = n->rb_right;
+			continue;
+		}
+
+		/* Go back up to the next area in address order */
+		for (;;) {
+			prev = n;
+			n = rb_parent(n);
+			if (!n)
+				goto check_highest;
+			if (prev == n->rb_left) {
+				va = rb_entry(n, struct vmap_area, rb_node);
+				goto check_current;
+			}
+		}
+	}
+
+check_highest:
+	/* The hole above the highest area */
+	addr = vstart;
+	if (!list_empty(&vmap_area_list)) {
+		va = list_entry(vmap_area_list.prev, struct vmap_area, list);
+		addr = max(addr, va->va_end);
+	}
+	addr = ALIGN(addr, align);
+	if (addr < vstart || addr + size < addr)
+		return 0;
+
+found:
+	if (addr + size > vend)
+		return 0;
+	return addr;
 }
 
 static void purge_vmap_area_lazy(void);
@@ -335,10 +476,8 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				int node, gfp_t gfp_mask)
 {
 	struct vmap_area *va;
-	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
-	struct vmap_area *first;
 
 	BUG_ON(!size);
 	BUG_ON(size & ~PAGE_MASK);
@@ -351,84 +490,14 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 retry:
 	spin_lock(&vmap_area_lock);
-	/*
-	 * Invalidate cache if we have more permissive parameters.
-	 * cached_hole_size notes the largest hole noticed _below_
-	 * the vmap_area cached in free_vmap_cache: if size fits
-	 * into that hole, we want to scan from vstart to reuse
-	 * the hole instead of allocating above free_vmap_cache.
-	 * Note that __free_vmap_area may update free_vmap_cache
-	 * without updating cached_hole_size or cached_align.
-	 */
-	if (!free_vmap_cache ||
-			size < cached_hole_size ||
-			vstart < cached_vstart ||
-			align < cached_align) {
-nocache:
-		cached_hole_size = 0;
-		free_vmap_cache = NULL;
-	}
-	/* record if we encounter less permissive parameters */
-	cached_vstart = vstart;
-	cached_align = align;
-
-	/* find starting point for our search */
-	if (free_vmap_cache) {
-		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-		addr = ALIGN(first->va_end, align);
-		if (addr < vstart)
-			goto nocache;
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-	} else {
-		addr = ALIGN(vstart, align);
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-		n = vmap_area_root.rb_node;
-		first = NULL;
-
-		while (n) {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				first = tmp;
-				if (tmp->va_start <= addr)
-					break;
-				n = n->rb_left;
-			} else
-				n = n->rb_right;
-		}
-
-		if (!first)
-			goto found;
-	}
-
-	/* from the starting point, walk areas until a suitable hole is found */
-	while (addr + size > first->va_start && addr + size <= vend) {
-		if (addr + cached_hole_size < first->va_start)
-			cached_hole_size = first->va_start - addr;
-		addr = ALIGN(first->va_end, align);
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-		n = rb_next(&first->rb_node);
-		if (n)
-			first = rb_entry(n, struct vmap_area, rb_node);
-		else
-			goto found;
-	}
-
-found:
-	if (addr + size > vend)
+	addr = __find_vmap_hole(size, align, vstart, vend);
+	if (!addr)
 		goto overflow;
 
 	va->va_start = addr;
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
-	free_vmap_cache = &va->rb_node;
 	spin_unlock(&vmap_area_lock);
 
 	BUG_ON(va->va_start & (align-1));
@@ -461,26 +530,18 @@ static void rcu_free_va(struct rcu_head *head)
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	struct rb_node *deepest;
+	struct list_head *next;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
 
-	if (free_vmap_cache) {
-		if (va->va_end < cached_vstart) {
-			free_vmap_cache = NULL;
-		} else {
-			struct vmap_area *cache;
-			cache = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-			if (va->va_start <= cache->va_start) {
-				free_vmap_cache = rb_prev(&va->rb_node);
-				/*
-				 * We don't try to update cached_hole_size or
-				 * cached_align, but it won't go very wrong.
-				 */
-			}
-		}
-	}
+	deepest = rb_augment_erase_begin(&va->rb_node);
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
+	next = va->list.next;
 	list_del_rcu(&va->list);
+	rb_augment_erase_end(deepest, vmap_area_augment_cb, NULL);
+	vmap_area_augment_next(next);
 
 	/*
 	 * Track the highest possible candidate for pcpu area
@@ -605,20 +666,19 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (sync)
 		purge_fragmented_blocks_allcpus();
 
-	rcu_read_lock();
-	list_for_each_entry_rcu(va, &vmap_area_list, list) {
-		if (va->flags & VM_LAZY_FREE) {
-			if (va->va_start < *start)
-				*start = va->va_start;
-			if (va->va_end > *end)
-				*end = va->va_end;
-			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
-			list_add_tail(&va->purge_list, &valist);
-			va->flags |= VM_LAZY_FREEING;
-			va->flags &= ~VM_LAZY_FREE;
-		}
+	spin_lock(&vmap_purge_lock);
+	list_splice_init(&vmap_purge_list, &valist);
+	spin_unlock(&vmap_purge_lock);
+
+	list_for_each_entry(va, &valist, purge_list) {
+		if (va->va_start < *start)
+			*start = va->va_start;
+		if (va->va_end > *end)
+			*end = va->va_end;
+		nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+		va->flags |= VM_LAZY_FREEING;
+		va->flags &= ~VM_LAZY_FREE;
 	}
-	rcu_read_unlock();
 
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
@@ -663,8 +723,11 @@ static void purge_vmap_area_lazy(void)
  */
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
-	va->flags |= VM_LAZY_FREE;
 	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
+	spin_lock(&vmap_purge_lock);
+	va->flags |= VM_LAZY_FREE;
+	list_add_tail(&va->purge_list, &vmap_purge_list);
+	spin_unlock(&vmap_purge_lock);
 	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
 		try_purge_vmap_area_lazy();
 }